@@ -0,0 +1,43 @@
+#!/bin/zsh
+# Generates the same static Cadmium models with the nested and the flat emissions,
+# and reports the time and peak memory of compiling each one and the size of its binary.
+# usage: ./compare_emissions.sh [kind] [widths] [depths]
+KIND=${1:-LI}
+WIDTHS=${2:-"2 5 10"}
+DEPTHS=${3:-"2 5 10"}
+PREFIX=emissions_`date +%Y%m%d`
+EXTERNAL=100
+INTERNAL=100
+EVENTS=events.txt
+
+mkdir -p ${PREFIX}
+cp events.txt ${PREFIX}/events.txt
+
+for D in ${=DEPTHS}; do
+	for W in ${=WIDTHS}; do
+		for EMISSION in nested flat; do
+			MODEL="${PREFIX}/${KIND}_DEVSTONE_D${D}_W${W}_${EMISSION}"
+			./cadmium-devstone   \
+				--kind=${KIND}    \
+				--width=${W} \
+				--depth=${D} \
+				--ext-cycles=${EXTERNAL} \
+				--int-cycles=${INTERNAL} \
+				--event-list=${EVENTS} \
+				--emission=${EMISSION} \
+				--output="${MODEL}.cpp" > /dev/null
+			# the compiler messages are kept in the log, a failed compilation has no binary to measure
+			if ! /usr/bin/time -f "%e %M" -o "${MODEL}.time" \
+				clang++ --std=c++17 -ftemplate-depth=2048 -pthread -Isimulators/cadmium/include -Isrc \
+					"${MODEL}.cpp" dhry/dhry_1.o dhry/dhry_2.o \
+					-o "${MODEL}" > "${MODEL}.log" 2>&1; then
+				echo "kind: ${KIND} width: ${W} depth: ${D} emission: ${EMISSION} compilation failed, see ${MODEL}.log"
+				continue
+			fi
+			COMPILATION=(`tail -n 1 "${MODEL}.time"`)
+			echo "kind: ${KIND} width: ${W} depth: ${D} emission: ${EMISSION}" \
+				"compile time (s): ${COMPILATION[1]} compiler peak RSS (KB): ${COMPILATION[2]}" \
+				"binary size (bytes): `stat -c %s ${MODEL}`"
+		done
+	done
+done
@@ -400,6 +400,13 @@
 #include <stdlib.h>
 //#include <cmalloc.h>
 
+#ifdef __cplusplus
+#define DHRY_THREAD_LOCAL thread_local
+#else
+#define DHRY_THREAD_LOCAL _Thread_local
+#endif
+                /* Globals are kept per thread (RTDEVS MODIFICATIONS) */
+
 #define Null 0 
                 /* Value of a Null pointer */
 #define true  1
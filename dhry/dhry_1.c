@@ -24,8 +24,11 @@
 #include "dhry_2.c"
 
 /* Global Variables: */
-int             Int_Glob;
-char            Ch_1_Glob;
+/* RTDEVS MODIFICATIONS -
+   Before : process wide globals
+   Now    : one copy per thread, so kernels can run concurrently */
+DHRY_THREAD_LOCAL int             Int_Glob;
+DHRY_THREAD_LOCAL char            Ch_1_Glob;
 
 
 class DhryStone {
@@ -33,6 +36,8 @@ class DhryStone {
     public:
         Rec_Pointer     Ptr_Glob,
                         Next_Ptr_Glob;
+        Rec_Type        Glob_Rec,
+                        Next_Glob_Rec;
         Boolean         Bool_Glob;
         char            Ch_2_Glob;
         int             Arr_1_Glob [50];
@@ -108,8 +113,11 @@ class DhryStone {
 
           /* Initializations */
 
-          Next_Ptr_Glob = (Rec_Pointer) malloc (sizeof (Rec_Type));
-          Ptr_Glob = (Rec_Pointer) malloc (sizeof (Rec_Type));
+          /* RTDEVS MODIFICATIONS -
+             Before : both records were malloc'ed on every run and never freed
+             Now    : records are owned by the object and reused across runs */
+          Next_Ptr_Glob = &Next_Glob_Rec;
+          Ptr_Glob = &Glob_Rec;
 
           Ptr_Glob->Ptr_Comp                    = Next_Ptr_Glob;
           Ptr_Glob->Discr                       = Ident_1;
@@ -437,4 +445,14 @@ class DhryStone {
 };
 
 
+/* RTDEVS MODIFICATIONS -
+   A single kernel per thread, reused by every model running on that thread.
+   Constructing a DhryStone per transition put ~10KB on the stack each time. */
+inline DhryStone& thread_dhrystone ()
+{
+  static thread_local DhryStone kernel;
+  return kernel;
+}
+
+
 #endif
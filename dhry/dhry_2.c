@@ -24,8 +24,8 @@
         /* i.e. no register variables   */
 #endif
 
-extern  int     Int_Glob;
-extern  char    Ch_1_Glob;
+extern  DHRY_THREAD_LOCAL int     Int_Glob;
+extern  DHRY_THREAD_LOCAL char    Ch_1_Glob;
 
 
 void Proc_6 (Enumeration Enum_Val_Par, Enumeration *Enum_Ref_Par)
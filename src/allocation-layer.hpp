@@ -0,0 +1,445 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ALLOCATION_LAYER_HPP
+#define ALLOCATION_LAYER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <new>
+#include <ostream>
+#include <string>
+
+#include <malloc.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * Replacement of the global operator new and delete, included once by each benchmark binary.
+ *
+ * Every allocation is served by the strategy selected when it is made:
+ * - system: malloc and free, without any header or bookkeeping.
+ * - pool: blocks of up to pool_max_block bytes come from free lists of each thread, by size classes of 16
+ *   bytes, refilled in chunks that are never returned. Bigger blocks use malloc.
+ * - arena: bump allocation from chunks of each thread, delete does nothing.
+ *
+ * The chunks of the pool and the arena are taken from a region reserved when one of them is selected, as big
+ * as the physical memory without reserving swap. Only their blocks carry a header, with their size and
+ * strategy, and delete tells them apart from the blocks of malloc by their address, so every block is freed
+ * correctly after the strategy changes. If the region can not be reserved or is exhausted, blocks come from malloc.
+ * With huge pages, the region is aligned to 2 MB and advised to be backed by transparent huge pages.
+ *
+ * With --allocation-stats the allocations, bytes and peak live bytes are counted separately for each phase of
+ * a benchmark. Allocations and bytes are counted by each thread on its own, and live bytes are added to the
+ * shared total in batches of live_bytes_batch, so the peaks are exact up to that amount per thread.
+ * Live bytes of the blocks of malloc are their usable size. Without it, nothing is counted.
+ */
+
+enum allocator_strategy {system_allocator, pool_allocator, arena_allocator};
+
+std::istream& operator>>(std::istream& in, allocator_strategy& strategy) {
+    std::string input;
+    in >> input;
+    if (input == "system") {
+        strategy = system_allocator;
+    } else if (input == "pool") {
+        strategy = pool_allocator;
+    } else if (input == "arena") {
+        strategy = arena_allocator;
+    } else {
+        in.setstate(std::ios_base::failbit);
+    }
+    return in;
+}
+
+std::ostream& operator<<(std::ostream& os, const allocator_strategy& strategy) {
+    switch (strategy) {
+        case system_allocator: return os << "system";
+        case pool_allocator: return os << "pool";
+        case arena_allocator: return os << "arena";
+    }
+    return os;
+}
+
+// Phases timed by the benchmarks, allocations made before selecting the allocator are not counted
+enum allocation_phase {arguments_phase, construction_phase, initialization_phase, simulation_phase, reporting_phase};
+
+const char* const allocation_phase_names[] = {"processing arguments", "constructing the models", "initializing the models", "running simulation", "reporting"};
+
+namespace allocation_layer {
+    const std::size_t header_bytes = 16;
+    const std::size_t pool_classes = 64;
+    const std::size_t pool_max_block = pool_classes * 16;
+    const std::size_t pool_chunk_bytes = 64 * 1024;
+    const std::size_t arena_chunk_bytes = 1024 * 1024;
+    const std::size_t phases = reporting_phase + 1;
+    const std::size_t counter_slots = 256;
+    const std::int64_t live_bytes_batch = 64 * 1024;
+
+    enum block_kind : std::uint32_t {pool_block, arena_block};
+
+    // Precedes every block of the pool and the arena, keeps the blocks aligned to 16 bytes
+    struct block_header {
+        std::uint64_t size;
+        block_kind kind;
+        std::uint32_t size_class; //only used by pool blocks
+    };
+    static_assert(sizeof(block_header) == header_bytes, "the header must keep the alignment of the blocks");
+
+    // Counters of a thread, only written by it unless the threads outnumber the slots and share the last one
+    struct alignas(64) thread_counters {
+        std::atomic<std::uint64_t> allocations[phases];
+        std::atomic<std::uint64_t> bytes[phases];
+    };
+
+    std::atomic<int> strategy{system_allocator};
+    std::atomic<int> phase{arguments_phase};
+    std::atomic<bool> counting{false};
+    std::atomic<std::int64_t> live_bytes{0};
+    std::atomic<std::int64_t> peak_live_bytes[phases];
+    thread_counters counters[counter_slots];
+    std::atomic<std::size_t> counters_taken{0};
+
+    thread_local thread_counters* local_counters = nullptr;
+    thread_local bool shared_counters = false;
+    thread_local std::int64_t pending_live_bytes = 0;
+
+    // Set before the pool or the arena are used, and never changed afterwards
+    const std::size_t huge_page_bytes = 2 * 1024 * 1024;
+    char* chunk_region = nullptr;
+    std::size_t chunk_region_bytes = 0;
+    bool huge_pages = false;
+    std::atomic<std::size_t> chunk_region_used{0};
+
+    thread_local void* pool_free_lists[pool_classes] = {};
+    thread_local char* arena_next = nullptr;
+    thread_local char* arena_end = nullptr;
+
+    // Adds the live bytes of the thread to the total, raising the peak of the phase
+    void flush_live_bytes() {
+        std::int64_t live = live_bytes.fetch_add(pending_live_bytes, std::memory_order_relaxed) + pending_live_bytes;
+        pending_live_bytes = 0;
+        std::atomic<std::int64_t>& peak = peak_live_bytes[phase.load(std::memory_order_relaxed)];
+        std::int64_t current = peak.load(std::memory_order_relaxed);
+        while (live > current && !peak.compare_exchange_weak(current, live, std::memory_order_relaxed)) {}
+    }
+
+    void add_to_counter(std::atomic<std::uint64_t>& counter, std::uint64_t value) {
+        if (shared_counters) {
+            counter.fetch_add(value, std::memory_order_relaxed);
+        } else {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+    }
+
+    void count_allocation(std::size_t size, std::size_t live) {
+        if (!local_counters) {
+            std::size_t slot = counters_taken.fetch_add(1, std::memory_order_relaxed);
+            shared_counters = (slot >= counter_slots - 1);
+            local_counters = &counters[shared_counters ? counter_slots - 1 : slot];
+        }
+        int current = phase.load(std::memory_order_relaxed);
+        add_to_counter(local_counters->allocations[current], 1);
+        add_to_counter(local_counters->bytes[current], size);
+        pending_live_bytes += static_cast<std::int64_t>(live);
+        if (pending_live_bytes >= live_bytes_batch) flush_live_bytes();
+    }
+
+    void count_deallocation(std::size_t live) {
+        pending_live_bytes -= static_cast<std::int64_t>(live);
+        if (pending_live_bytes <= -live_bytes_batch) flush_live_bytes();
+    }
+
+    // Reserves the region of the chunks, returns false if it failed
+    bool reserve_chunk_region(bool advise_huge_pages) {
+        if (chunk_region) return true;
+        long pages = sysconf(_SC_PHYS_PAGES);
+        long page_bytes = sysconf(_SC_PAGESIZE);
+        if (pages <= 0 || page_bytes <= 0) return false;
+        std::size_t bytes = static_cast<std::size_t>(pages) * static_cast<std::size_t>(page_bytes) / huge_page_bytes * huge_page_bytes;
+        void* mapped = mmap(nullptr, bytes + huge_page_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mapped == MAP_FAILED) return false;
+        char* aligned = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(mapped) + huge_page_bytes - 1) / huge_page_bytes * huge_page_bytes);
+        huge_pages = advise_huge_pages && madvise(aligned, bytes, MADV_HUGEPAGE) == 0;
+        chunk_region_bytes = bytes;
+        chunk_region = aligned;
+        return true;
+    }
+
+    bool in_chunk_region(const void* p) {
+        return reinterpret_cast<std::uintptr_t>(p) - reinterpret_cast<std::uintptr_t>(chunk_region) < chunk_region_bytes;
+    }
+
+    // Memory for the chunks of the pool and the arena, which are never freed
+    char* allocate_chunk(std::size_t bytes) {
+        if (!chunk_region) return nullptr;
+        std::size_t offset = chunk_region_used.fetch_add(bytes, std::memory_order_relaxed);
+        if (offset + bytes > chunk_region_bytes) return nullptr;
+        return chunk_region + offset;
+    }
+
+    block_header* pool_allocate(std::size_t size) {
+        std::uint32_t size_class = static_cast<std::uint32_t>((size + 15) / 16);
+        if (size_class == 0) size_class = 1;
+        void*& free_list = pool_free_lists[size_class - 1];
+        if (!free_list) {
+            std::size_t block_bytes = header_bytes + size_class * 16;
+            char* chunk = allocate_chunk(pool_chunk_bytes);
+            if (!chunk) return nullptr;
+            for (std::size_t offset = 0; offset + block_bytes <= pool_chunk_bytes; offset += block_bytes) {
+                char* block = chunk + offset + header_bytes;
+                *reinterpret_cast<void**>(block) = free_list;
+                free_list = block;
+            }
+        }
+        char* block = static_cast<char*>(free_list);
+        free_list = *reinterpret_cast<void**>(block);
+        block_header* header = reinterpret_cast<block_header*>(block - header_bytes);
+        header->kind = pool_block;
+        header->size_class = size_class;
+        return header;
+    }
+
+    block_header* arena_allocate(std::size_t size) {
+        std::size_t block_bytes = header_bytes + (size + 15) / 16 * 16;
+        if (static_cast<std::size_t>(arena_end - arena_next) < block_bytes) {
+            std::size_t chunk_bytes = (block_bytes > arena_chunk_bytes ? block_bytes : arena_chunk_bytes);
+            char* chunk = allocate_chunk(chunk_bytes);
+            if (!chunk) return nullptr;
+            arena_next = chunk;
+            arena_end = chunk + chunk_bytes;
+        }
+        block_header* header = reinterpret_cast<block_header*>(arena_next);
+        arena_next += block_bytes;
+        header->kind = arena_block;
+        return header;
+    }
+
+    // Returns nullptr if there is no memory left
+    void* allocate(std::size_t size, std::size_t alignment) {
+        int selected = strategy.load(std::memory_order_relaxed);
+        if (selected != system_allocator && alignment <= header_bytes) {
+            block_header* header = nullptr;
+            if (selected == arena_allocator) {
+                header = arena_allocate(size);
+            } else if (size <= pool_max_block) {
+                header = pool_allocate(size);
+            }
+            //bigger blocks of the pool, and blocks without chunks left, are allocated by the system
+            if (header) {
+                header->size = size;
+                if (counting.load(std::memory_order_relaxed)) count_allocation(size, size);
+                return reinterpret_cast<char*>(header) + header_bytes;
+            }
+        }
+        void* p = nullptr;
+        if (alignment <= alignof(std::max_align_t)) {
+            p = std::malloc(size ? size : 1);
+        } else if (posix_memalign(&p, alignment, size ? size : 1) != 0) {
+            p = nullptr;
+        }
+        if (p && counting.load(std::memory_order_relaxed)) count_allocation(size, malloc_usable_size(p));
+        return p;
+    }
+
+    void deallocate(void* p) {
+        if (!p) return;
+        if (!in_chunk_region(p)) {
+            if (counting.load(std::memory_order_relaxed)) count_deallocation(malloc_usable_size(p));
+            std::free(p);
+            return;
+        }
+        block_header* header = reinterpret_cast<block_header*>(static_cast<char*>(p) - header_bytes);
+        if (counting.load(std::memory_order_relaxed)) count_deallocation(header->size);
+        if (header->kind == pool_block) {
+            void*& free_list = pool_free_lists[header->size_class - 1];
+            *static_cast<void**>(p) = free_list;
+            free_list = p;
+        }
+        //arena blocks are never freed
+    }
+
+    void* allocate_or_throw(std::size_t size, std::size_t alignment) {
+        void* p = allocate(size, alignment);
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+}
+
+// Selects the strategy used from now on, the pool and the arena reserve the region of their chunks
+void set_allocator_strategy(allocator_strategy strategy) {
+    if (strategy != system_allocator) allocation_layer::reserve_chunk_region(false);
+    allocation_layer::strategy.store(strategy, std::memory_order_relaxed);
+}
+
+allocator_strategy current_allocator_strategy() {
+    return static_cast<allocator_strategy>(allocation_layer::strategy.load(std::memory_order_relaxed));
+}
+
+// Reserves the region of the chunks of the pool and the arena backed by huge pages, returns false if it failed.
+// It has to be called before the pool or the arena are selected.
+bool enable_huge_pages() {
+    return allocation_layer::reserve_chunk_region(true) && allocation_layer::huge_pages;
+}
+
+bool huge_pages_enabled() {
+    return allocation_layer::huge_pages;
+}
+
+bool allocation_stats_enabled() {
+    return allocation_layer::counting.load(std::memory_order_relaxed);
+}
+
+// Sum of the AnonHugePages of the mappings of the process overlapping [begin, end), in kilobytes.
+// The whole process by default. Each mapping of /proc/self/smaps starts with a "begin-end perms ..." line.
+long anon_huge_pages_kb(std::uintptr_t begin = 0, std::uintptr_t end = UINTPTR_MAX) {
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool overlaps = false;
+    long total = 0;
+    while (std::getline(smaps, line)) {
+        std::size_t name_end = line.find_first_of(" \t");
+        if (name_end != std::string::npos && name_end > 0 && line[name_end - 1] != ':') {
+            std::size_t dash = line.find('-');
+            if (dash == std::string::npos || dash > name_end) continue;
+            std::uintptr_t mapping_begin = std::strtoull(line.c_str(), nullptr, 16);
+            std::uintptr_t mapping_end = std::strtoull(line.c_str() + dash + 1, nullptr, 16);
+            overlaps = (mapping_begin < end && begin < mapping_end);
+        } else if (overlaps && line.compare(0, 15, "AnonHugePages: ") == 0) {
+            total += std::strtol(line.c_str() + 15, nullptr, 10);
+        }
+    }
+    return total;
+}
+
+// AnonHugePages of the region of the chunks of the pool and the arena, in kilobytes
+long chunk_region_huge_pages_kb() {
+    if (!allocation_layer::chunk_region) return 0;
+    std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(allocation_layer::chunk_region);
+    return anon_huge_pages_kb(begin, begin + allocation_layer::chunk_region_bytes);
+}
+
+// Selects the strategy given by --allocator before the options are parsed, so they are parsed with it too,
+// reserves the huge pages if --huge-pages is given and starts counting if --allocation-stats is given.
+// Returns false if the value is not a strategy, which the parsing of the options reports afterwards.
+bool select_allocator(int argc, char* argv[]) {
+    const std::string option = "--allocator";
+    allocator_strategy selected = system_allocator;
+    bool valid = true;
+    bool huge_pages = false;
+    for (int i = 1; i < argc; i++) {
+        std::string value;
+        if (std::strcmp(argv[i], "--huge-pages") == 0) {
+            huge_pages = true;
+            continue;
+        } else if (std::strcmp(argv[i], "--allocation-stats") == 0) {
+            allocation_layer::counting.store(true, std::memory_order_relaxed);
+            continue;
+        } else if (argv[i] == option && i + 1 < argc) {
+            value = argv[i + 1];
+        } else if (std::strncmp(argv[i], "--allocator=", option.size() + 1) == 0) {
+            value = argv[i] + option.size() + 1;
+        } else {
+            continue;
+        }
+        if (value == "system") selected = system_allocator;
+        else if (value == "pool") selected = pool_allocator;
+        else if (value == "arena") selected = arena_allocator;
+        else valid = false;
+    }
+    if (huge_pages && selected != system_allocator) enable_huge_pages();
+    set_allocator_strategy(selected);
+    return valid;
+}
+
+// Starts counting the allocations of a phase, its peak is at least the bytes live.
+// Phases started again, as in sweeps, keep adding to their counters and peaks.
+void start_allocation_phase(allocation_phase phase) {
+    using namespace allocation_layer;
+    if (counting.load(std::memory_order_relaxed)) {
+        flush_live_bytes();
+        std::int64_t live = live_bytes.load(std::memory_order_relaxed);
+        std::int64_t current = peak_live_bytes[phase].load(std::memory_order_relaxed);
+        while (live > current && !peak_live_bytes[phase].compare_exchange_weak(current, live, std::memory_order_relaxed)) {}
+    }
+    allocation_layer::phase.store(phase, std::memory_order_relaxed);
+}
+
+// Prints the allocations of every phase up to the last one, the report is not counted
+void print_allocation_stats(std::ostream& os, allocation_phase last=simulation_phase) {
+    using namespace allocation_layer;
+    start_allocation_phase(reporting_phase);
+    os << "allocator: " << current_allocator_strategy() << std::endl;
+    if (counting.load(std::memory_order_relaxed)) {
+        std::size_t slots = std::min(counters_taken.load(), counter_slots);
+        for (int phase = arguments_phase; phase <= last; phase++) {
+            std::uint64_t allocations = 0;
+            std::uint64_t bytes = 0;
+            for (std::size_t slot = 0; slot < slots; slot++) {
+                allocations += counters[slot].allocations[phase].load(std::memory_order_relaxed);
+                bytes += counters[slot].bytes[phase].load(std::memory_order_relaxed);
+            }
+            os << "allocations " << allocation_phase_names[phase] << ": " << allocations
+               << " bytes: " << bytes
+               << " peak live bytes: " << std::max<std::int64_t>(peak_live_bytes[phase].load(), 0) << std::endl;
+        }
+    }
+    if (huge_pages_enabled()) {
+        std::size_t used = std::min(chunk_region_used.load(), chunk_region_bytes);
+        os << "huge pages region used: " << used << " bytes AnonHugePages of the region: " << chunk_region_huge_pages_kb()
+           << " KB of the process: " << anon_huge_pages_kb() << " KB" << std::endl;
+    }
+}
+
+void* operator new(std::size_t size) { return allocation_layer::allocate_or_throw(size, alignof(std::max_align_t)); }
+void* operator new[](std::size_t size) { return allocation_layer::allocate_or_throw(size, alignof(std::max_align_t)); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return allocation_layer::allocate(size, alignof(std::max_align_t)); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return allocation_layer::allocate(size, alignof(std::max_align_t)); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocation_layer::allocate_or_throw(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocation_layer::allocate_or_throw(size, static_cast<std::size_t>(alignment)); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocation_layer::allocate(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocation_layer::allocate(size, static_cast<std::size_t>(alignment)); }
+
+void operator delete(void* p) noexcept { allocation_layer::deallocate(p); }
+void operator delete[](void* p) noexcept { allocation_layer::deallocate(p); }
+void operator delete(void* p, std::size_t) noexcept { allocation_layer::deallocate(p); }
+void operator delete[](void* p, std::size_t) noexcept { allocation_layer::deallocate(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { allocation_layer::deallocate(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { allocation_layer::deallocate(p); }
+void operator delete(void* p, std::align_val_t) noexcept { allocation_layer::deallocate(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { allocation_layer::deallocate(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { allocation_layer::deallocate(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { allocation_layer::deallocate(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { allocation_layer::deallocate(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { allocation_layer::deallocate(p); }
+
+#endif // ALLOCATION_LAYER_HPP
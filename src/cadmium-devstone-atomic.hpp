@@ -30,7 +30,7 @@
 #include<cadmium/modeling/message_bag.hpp>
 #include<limits>
 
-#include "../dhry/dhry_1.c"
+#include "workload-kernels.hpp"
 
 
 /**
@@ -41,6 +41,7 @@
  * - a Dhrystone for InternalCycles on each Internal transition,
  * - a Dhrystone for ExternalCycles on each External transition,
  * - the time advance after each external transition is Period.
+ * The Dhrystone can be replaced by another workload kernel (see workload-kernels.hpp).
 */
 
 //  an integer input and output port for the model
@@ -51,18 +52,14 @@ struct devstone_atomic_defs{
 };
 
 
+// State, ports and output shared by the devstone atomics, whatever the way their workload is given
 template<typename TIME>
-class devstone_atomic {
+class devstone_atomic_base {
+protected:
     using defs=devstone_atomic_defs;
 public:
     // default constructor
-    constexpr devstone_atomic() noexcept {
-        //preparing the output bag, since we return always same message
-        cadmium::get_messages<typename defs::out>(outbag).emplace_back(1);
-    }
-
-    constexpr devstone_atomic(int ext_cycles, int int_cycles, TIME time_advance) noexcept
-        : period(time_advance), external_cycles(ext_cycles), internal_cycles(int_cycles){
+    constexpr devstone_atomic_base() noexcept {
         //preparing the output bag, since we return always same message
         cadmium::get_messages<typename defs::out>(outbag).emplace_back(1);
     }
@@ -76,6 +73,28 @@ public:
     using input_ports=std::tuple<typename defs::in>;
     using output_ports=std::tuple<typename defs::out>;
 
+protected:
+    using outbag_t=typename cadmium::make_message_bags<output_ports>::type;
+    outbag_t outbag;
+
+public:
+    outbag_t output() const {
+        return outbag;
+    }
+};
+
+template<typename TIME>
+class devstone_atomic : public devstone_atomic_base<TIME> {
+    using defs=devstone_atomic_defs;
+public:
+    using typename devstone_atomic_base<TIME>::input_ports;
+
+    // default constructor
+    constexpr devstone_atomic() noexcept = default;
+
+    constexpr devstone_atomic(int ext_cycles, int int_cycles, TIME time_advance, workload kernel=workload()) noexcept
+        : period(time_advance), external_cycles(ext_cycles), internal_cycles(int_cycles), work(kernel){}
+
 protected:
     /*
      * This model executes:
@@ -87,18 +106,17 @@ protected:
     TIME period=std::numeric_limits<float>::infinity();
     int external_cycles=-1;
     int internal_cycles=-1;
-    using outbag_t=typename cadmium::make_message_bags<output_ports>::type;
-    outbag_t outbag;
+    workload work;
 
 public:
     void internal_transition() {
-        DhryStone().dhrystoneRun(internal_cycles);
-        state--;
+        run_workload(work, internal_cycles);
+        this->state--;
     }
 
     void external_transition(TIME e, typename cadmium::make_message_bags<input_ports>::type mbs) {
-        DhryStone().dhrystoneRun(external_cycles);
-        state+= cadmium::get_messages<typename defs::in>(mbs).size();
+        run_workload(work, external_cycles);
+        this->state+= cadmium::get_messages<typename defs::in>(mbs).size();
     }
 
     void confluence_transition(TIME e, typename cadmium::make_message_bags<input_ports>::type mbs) {
@@ -106,12 +124,45 @@ public:
         external_transition(e, mbs);
     }
 
-    outbag_t output() const {
-        return outbag;
+    TIME time_advance() const {
+        return (this->state!=0?period:std::numeric_limits<TIME>::infinity());
+    }
+};
+
+/**
+ * The devstone atomic with its workload as template parameters, instead of members set by the constructor.
+ * It only holds the state and the output of the atomics, the transitions and the time advance are specialized
+ * for each configuration: transitions without cycles or with the null kernel do not run any workload, and
+ * the period is a constant.
+ */
+template<typename TIME, int EXTERNAL_CYCLES, int INTERNAL_CYCLES, int PERIOD,
+         workload_kernel KERNEL=dhrystone_kernel, std::size_t BUFFER_BYTES=(1 << 20)>
+class devstone_constant_atomic : public devstone_atomic_base<TIME> {
+    using defs=devstone_atomic_defs;
+    static constexpr workload work{KERNEL, BUFFER_BYTES};
+    static constexpr bool internal_work = (KERNEL != null_kernel && INTERNAL_CYCLES > 0);
+    static constexpr bool external_work = (KERNEL != null_kernel && EXTERNAL_CYCLES > 0);
+    static constexpr TIME period = static_cast<TIME>(PERIOD);
+public:
+    using typename devstone_atomic_base<TIME>::input_ports;
+
+    void internal_transition() {
+        if constexpr (internal_work) run_workload(work, INTERNAL_CYCLES);
+        this->state--;
+    }
+
+    void external_transition(TIME e, typename cadmium::make_message_bags<input_ports>::type mbs) {
+        if constexpr (external_work) run_workload(work, EXTERNAL_CYCLES);
+        this->state+= cadmium::get_messages<typename defs::in>(mbs).size();
+    }
+
+    void confluence_transition(TIME e, typename cadmium::make_message_bags<input_ports>::type mbs) {
+        internal_transition();
+        external_transition(e, mbs);
     }
 
     TIME time_advance() const {
-        return (state!=0?period:std::numeric_limits<TIME>::infinity());
+        return (this->state!=0?period:std::numeric_limits<TIME>::infinity());
     }
 };
 
@@ -1,9 +1,12 @@
 #include <iostream>
 #include <chrono>
 #include <fstream>
-#include <regex>
+#include <sstream>
 #include <boost/program_options.hpp>
 #include <cadmium/engine/pdevs_runner.hpp>
+#include "workload-calibration.hpp"
+#include "topology.hpp"
+#include "source-writer.hpp"
 
 using namespace std;
 namespace po=boost::program_options;
@@ -14,7 +17,7 @@ using hclock=chrono::high_resolution_clock;
 // Reason is to avoid adding the overhead of constructing a recursive model at the time of evaluation,
 // which is artificial and does not match common usage scenario for the simulator.
 
-//For reference, we want to generate the file cadmium-ref-LI.cpp when parameters are W=3, D=3
+//For reference, we want to generate the files cadmium-ref-LI.cpp and cadmium-ref-HI.cpp when parameters are W=3, D=3
 
 const string header =
 R"/(
@@ -50,16 +53,32 @@ R"/(
 #include <cadmium/engine/pdevs_runner.hpp>
 #include "cadmium-devstone-atomic.hpp"
 #include "cadmium-event-reader.hpp"
+#include "allocation-layer.hpp"
+)/";
 
+//Ports of the coupled models, HI and HO have a second input port and HO a second output port
+source_writer& generate_ports(const devstone_topology& topology, source_writer& os){
+    bool two_inputs = coupled_input_ports(topology.kind) > 1;
+    bool two_outputs = coupled_output_ports(topology.kind) > 1;
+    os << R"/(
 // Ports for coupled models, we use the same in every level
 struct coupled_in_port : public cadmium::in_port<int>{};
 struct coupled_out_port : public cadmium::out_port<int>{};
-using coupled_in_ports = std::tuple<coupled_in_port>;
-using coupled_out_ports = std::tuple<coupled_out_port>;
-
-//Devstones have no Internal coupling
+)/";
+    if (two_inputs) {
+        os << "struct coupled_in_port2 : public cadmium::in_port<int>{};\n";
+    }
+    if (two_outputs) {
+        os << "struct coupled_out_port2 : public cadmium::out_port<int>{};\n";
+    }
+    os << "using coupled_in_ports = std::tuple<coupled_in_port" << (two_inputs ? ", coupled_in_port2" : "") << ">;\n";
+    os << "using coupled_out_ports = std::tuple<coupled_out_port" << (two_outputs ? ", coupled_out_port2" : "") << ">;\n";
+    os << R"/(
+//Levels without internal couplings
 using ics=std::tuple<>;
 )/";
+    return os;
+}
 
 const string level_0 = R"/(
 //Level 0 has always a single model
@@ -68,7 +87,18 @@ struct devstone_atomic_L0_0 : configured_atomic_devstone<TIME>{};
 
 )/";
 
-ostream& configure_atomic(int internal_cycles, int external_cycles, int period, ostream& os){
+string kernel_identifier(workload_kernel kernel){
+    switch (kernel) {
+        case dhrystone_kernel: return "dhrystone_kernel";
+        case pointer_chase_kernel: return "pointer_chase_kernel";
+        case stream_fma_kernel: return "stream_fma_kernel";
+        case branchy_kernel: return "branchy_kernel";
+        case null_kernel: return "null_kernel";
+    }
+    throw runtime_error("unknown workload kernel");
+}
+
+source_writer& configure_atomic(int internal_cycles, int external_cycles, int period, const workload& work, source_writer& os){
     os << R"/(
 //A configured version of the devstone atomic, we use same configuration in every atomic.
 template<typename TIME>
@@ -76,7 +106,14 @@ struct configured_atomic_devstone : devstone_atomic<TIME>{
     configured_atomic_devstone(){
         devstone_atomic<TIME>::period = )/" << period << R"/(;
         devstone_atomic<TIME>::external_cycles = )/" << external_cycles << R"/(;
-        devstone_atomic<TIME>::internal_cycles = )/" << internal_cycles << R"/(;
+        devstone_atomic<TIME>::internal_cycles = )/" << internal_cycles << R"/(;)/";
+    //the default kernel is dhrystone, it is only configured when another one was requested
+    if (work.kernel != dhrystone_kernel) {
+        os << R"/(
+        devstone_atomic<TIME>::work.kernel = )/" << kernel_identifier(work.kernel) << R"/(;
+        devstone_atomic<TIME>::work.buffer_bytes = )/" << work.buffer_bytes << R"/(;)/";
+    }
+    os << R"/(
     }
 };
 
@@ -84,87 +121,228 @@ struct configured_atomic_devstone : devstone_atomic<TIME>{
     return os;
 }
 
-ostream& generate_coupled_model(int level, int width, ostream &os) {
+//Text as a C++ string literal, quotes included. Control characters are escaped in octal, with 3 digits so
+//the next character is never taken as part of the escape.
+string cpp_string_literal(const string& text){
+    string literal = "\"";
+    for (char c : text) {
+        unsigned char code = static_cast<unsigned char>(c);
+        switch (c) {
+            case '"': literal += "\\\""; break;
+            case '\\': literal += "\\\\"; break;
+            case '\n': literal += "\\n"; break;
+            case '\t': literal += "\\t"; break;
+            case '\r': literal += "\\r"; break;
+            default:
+                if (code < 0x20 || code == 0x7f) {
+                    literal += '\\';
+                    literal += char('0' + (code >> 6));
+                    literal += char('0' + ((code >> 3) & 7));
+                    literal += char('0' + (code & 7));
+                } else {
+                    literal += c;
+                }
+        }
+    }
+    return literal + "\"";
+}
+
+source_writer& configure_event_reader(const string& event_list, source_writer& os){
     os << R"/(
-//coupled
-using L)/" << level << R"/(_submodels=cadmium::modeling::models_tuple<)/";
-    for (int atom=0; atom < width; atom++){
-        os  << "devstone_atomic_L" << level - 1 << "_" << atom << ", ";
-    }
-    os << "L" << level -1 << "_coupled>;" << endl;
-    string haystack_init = R"/(
-using L<<LEVEL>>_eics=std::tuple<
-    cadmium::modeling::EIC<coupled_in_port, L<<PRELEVEL>>_coupled, coupled_in_port>)/";
-     string haystack_end = R"/(
->;
-using L<<LEVEL>>_eocs=std::tuple<
-    cadmium::modeling::EOC<L<<PRELEVEL>>_coupled,coupled_out_port, coupled_out_port>
->;
+//The event reader of the model, reading the event list given when the model was generated.
 template<typename TIME>
-using L<<LEVEL>>_coupled=cadmium::modeling::coupled_model<TIME, coupled_in_ports, coupled_out_ports, L<<LEVEL>>_submodels, L<<LEVEL>>_eics, L<<LEVEL>>_eocs, ics>;
+struct configured_event_reader : devstone_event_reader<TIME>{
+    configured_event_reader() : devstone_event_reader<TIME>()/" << cpp_string_literal(event_list) << R"/(){}
+};
+
 )/";
-    os << regex_replace(
-                        regex_replace( haystack_init, regex(R"/(<<LEVEL>>)/"), to_string(level)),
-                        regex(R"/(<<PRELEVEL>>)/"),
-                        to_string(level-1)
-                        );
-    for (int atom=0; atom < width; atom++){
-        os << R"/(,
-    cadmium::modeling::EIC<coupled_in_port, devstone_atomic_L)/" << level-1 << "_" << atom <<R"/(, devstone_atomic_defs::in>)/";
-    }
-    os << regex_replace(
-                        regex_replace( haystack_end, regex(R"/(<<LEVEL>>)/"), to_string(level)),
-                        regex(R"/(<<PRELEVEL>>)/"),
-                        to_string(level-1)
-                        );
     return os;
 }
-        
-ostream& generate_level(int level, int width, ostream& os){
-    if (level == 0) throw runtime_error("level 0 model is generated by another function");
-    os <<
-R"/(//Level )/" << level << R"/(
-//atomics)/";
-    for (int atom=0; atom < width; atom++){
-        os << R"/(
+
+//With the runtime parameters the workload and the event list are read from the command line of the generated model,
+//the values given to the generator are the defaults, so a single compilation of the topology serves a whole sweep.
+//With the constant parameters the workload is a template argument of the atomics, and their transitions are specialized for it.
+enum parameters_mode {compiled_parameters, runtime_parameters_mode, constant_parameters};
+
+source_writer& configure_constant_atomic(int internal_cycles, int external_cycles, int period, const workload& work, source_writer& os){
+    os << R"/(
+//A configured version of the devstone atomic, the configuration is a constant of the type of every atomic.
 template<typename TIME>
-struct devstone_atomic_L)/" << level << "_" << atom << R"/( : configured_atomic_devstone<TIME>{};)/";
+struct configured_atomic_devstone : devstone_constant_atomic<TIME, )/" << external_cycles << ", " << internal_cycles << ", " << period
+       << ", " << kernel_identifier(work.kernel) << ", " << work.buffer_bytes << R"/(>{};
+
+)/";
+    return os;
+}
+
+source_writer& configure_runtime_parameters(int internal_cycles, int external_cycles, int period, const workload& work, const string& event_list, source_writer& os){
+    os << R"/(
+#include "runtime-parameters.hpp"
+
+//The parameters given when the model was generated, used for the options missing in the command line of the model
+const generated_model_parameters generated_defaults{)/" << period << ", " << external_cycles << ", " << internal_cycles
+       << ", workload{" << kernel_identifier(work.kernel) << ", " << work.buffer_bytes << "}, " << cpp_string_literal(event_list) << R"/(};
+
+//A configured version of the devstone atomic, every atomic takes the parameters read from the command line.
+template<typename TIME>
+struct configured_atomic_devstone : devstone_atomic<TIME>{
+    configured_atomic_devstone(){
+        devstone_atomic<TIME>::period = runtime_parameters().period;
+        devstone_atomic<TIME>::external_cycles = runtime_parameters().external_cycles;
+        devstone_atomic<TIME>::internal_cycles = runtime_parameters().internal_cycles;
+        devstone_atomic<TIME>::work = runtime_parameters().work;
     }
-    if (level == 1){ //only 1 submodel 0_0
-    os <<
-R"/(
-//coupled
-using L1_submodels=cadmium::modeling::models_tuple<devstone_atomic_L0_0>;
-using L1_eics=std::tuple<
-    cadmium::modeling::EIC<coupled_in_port, devstone_atomic_L0_0, devstone_atomic_defs::in>
->;
-using L1_eocs=std::tuple<
-    cadmium::modeling::EOC<devstone_atomic_L0_0, devstone_atomic_defs::out, coupled_out_port>
->;
+};
+
+//The event reader of the model, reading the event list given in the command line.
 template<typename TIME>
-using L1_coupled=cadmium::modeling::coupled_model<TIME, coupled_in_ports, coupled_out_ports, L1_submodels, L1_eics, L1_eocs, ics>;
+struct configured_event_reader : devstone_event_reader<TIME>{
+    configured_event_reader() : devstone_event_reader<TIME>(runtime_parameters().event_list){}
+};
+
 )/";
+    return os;
+}
+
+//Names of the models and ports of the topology in the generated source
+source_writer& write_model_name(const devstone_topology& topology, topology_model model, source_writer& os){
+    if (model.is_coupled) {
+        return os << 'L' << topology.coupleds[model.index].level << "_coupled";
+    }
+    const topology_atomic& atomic = topology.atomics[model.index];
+    os << "devstone_atomic_L" << atomic.level << '_' << atomic.column;
+    if (atomic.row != topology_atomic::no_row) {
+        os << '_' << atomic.row;
+    }
+    return os;
+}
+
+const char* port_name(topology_port port){
+    switch (port) {
+        case atomic_in: return "devstone_atomic_defs::in";
+        case atomic_out: return "devstone_atomic_defs::out";
+        case coupled_in1: return "coupled_in_port";
+        case coupled_in2: return "coupled_in_port2";
+        case coupled_out1: return "coupled_out_port";
+        case coupled_out2: return "coupled_out_port2";
+    }
+    throw runtime_error("unknown topology port");
+}
+
+//Emits the couplings of a kind as the elements of a tuple
+source_writer& generate_couplings(const devstone_topology& topology, const topology_coupled& coupled, topology_coupling_kind kind, source_writer& os) {
+    bool first = true;
+    for (uint32_t c=coupled.first_coupling; c < coupled.first_coupling + coupled.couplings; c++){
+        const topology_coupling& coupling = topology.couplings[c];
+        if (coupling.kind != kind) continue;
+        os << (first ? "\n" : ",\n");
+        first = false;
+        switch (kind) {
+            case topology_eic:
+                os << "    cadmium::modeling::EIC<" << port_name(coupling.from_port) << ", ";
+                write_model_name(topology, coupling.to, os) << ", " << port_name(coupling.to_port) << '>';
+                break;
+            case topology_eoc:
+                os << "    cadmium::modeling::EOC<";
+                write_model_name(topology, coupling.from, os) << ", " << port_name(coupling.from_port) << ", " << port_name(coupling.to_port) << '>';
+                break;
+            case topology_ic:
+                os << "    cadmium::modeling::IC<";
+                write_model_name(topology, coupling.from, os) << ", " << port_name(coupling.from_port) << ", ";
+                write_model_name(topology, coupling.to, os) << ", " << port_name(coupling.to_port) << '>';
+                break;
+        }
+    }
+    return os;
+}
+
+source_writer& generate_coupled_model(const devstone_topology& topology, const topology_coupled& coupled, source_writer& os) {
+    uint32_t level = coupled.level;
+    os << R"/(
+//coupled
+using L)/" << level << R"/(_submodels=cadmium::modeling::models_tuple<)/";
+    for (uint32_t s=coupled.first_submodel; s < coupled.first_submodel + coupled.submodels; s++){
+        if (s > coupled.first_submodel) os << ", ";
+        write_model_name(topology, topology.submodels[s], os);
+    }
+    os << ">;\n";
+    bool has_ics = false;
+    for (uint32_t c=coupled.first_coupling; c < coupled.first_coupling + coupled.couplings; c++){
+        has_ics = has_ics || topology.couplings[c].kind == topology_ic;
+    }
+    os << "using L" << level << "_eics=std::tuple<";
+    generate_couplings(topology, coupled, topology_eic, os);
+    os << "\n>;\nusing L" << level << "_eocs=std::tuple<";
+    generate_couplings(topology, coupled, topology_eoc, os);
+    if (has_ics) {
+        os << "\n>;\nusing L" << level << "_ics=std::tuple<";
+        generate_couplings(topology, coupled, topology_ic, os);
+    }
+    os << "\n>;\ntemplate<typename TIME>\nusing L" << level << "_coupled=cadmium::modeling::coupled_model<TIME, coupled_in_ports, coupled_out_ports, L"
+       << level << "_submodels, L" << level << "_eics, L" << level << "_eocs, ";
+    if (has_ics) {
+        os << 'L' << level << "_ics";
     } else {
-        generate_coupled_model(level, width, os);
+        os << "ics";
     }
+    os << ">;\n";
     return os;
 }
-        
-ostream& generate_top_models(int depth, int width, ostream& os){
-    //creating the last coupled model
+
+source_writer& generate_atomic(const devstone_topology& topology, size_t atomic, source_writer& os){
     os << R"/(
-//Level )/" << depth << " has no atomics because it is the last level";
-    generate_coupled_model(depth, width, os);
+template<typename TIME>
+struct )/";
+    return write_model_name(topology, topology_model{uint32_t(atomic), false}, os) << R"/( : configured_atomic_devstone<TIME>{};)/";
+}
+
+//Emits the atomics of a level, the coupled model of the level and the TOP model after the last level
+source_writer& generate_levels(const devstone_topology& topology, source_writer& os){
+    size_t next_atomic = 1; //the atomic of level 0 is generated by another function
+    for (const topology_coupled& coupled : topology.coupleds){
+        if (coupled.level < topology.depth) {
+            os << R"/(//Level )/" << coupled.level << R"/(
+//atomics)/";
+            for (; next_atomic < topology.atomics.size() && topology.atomics[next_atomic].level == coupled.level; next_atomic++){
+                generate_atomic(topology, next_atomic, os);
+            }
+        } else {
+            os << R"/(
+//Level )/" << coupled.level << " has no atomics because it is the last level";
+        }
+        generate_coupled_model(topology, coupled, os);
+    }
+    return os;
+}
+
+//Emits every atomic and the coupled model of the last level of a flattened topology, which holds all of them, so
+//no coupled model is nested in another one
+source_writer& generate_flat_levels(const devstone_topology& flat, source_writer& os){
+    if (flat.coupleds.empty()) return os;
+    os << R"/(//Levels flattened into the last one
+//atomics)/";
+    for (size_t atomic = 1; atomic < flat.atomics.size(); atomic++){ //the atomic of level 0 is generated by another function
+        generate_atomic(flat, atomic, os);
+    }
+    return generate_coupled_model(flat, flat.coupleds.front(), os);
+}
+
+source_writer& generate_top_models(const devstone_topology& topology, source_writer& os){
     //creating the top model coupling the last coupled model and the input of external events
    os << R"/(
 //TOP model conecting a generator of events to the input
 using TOP_coupled_in_ports=std::tuple<>;
 using TOP_coupled_out_ports=std::tuple<>;
-using TOP_submodels=cadmium::modeling::models_tuple<devstone_event_reader, L)/" << depth << R"/(_coupled>;
+using TOP_submodels=cadmium::modeling::models_tuple<configured_event_reader, L)/" << topology.depth << R"/(_coupled>;
 using TOP_eics=std::tuple<>;
 using TOP_eocs=std::tuple<>;
-using TOP_ics=std::tuple<
-cadmium::modeling::IC<devstone_event_reader, devstone_event_reader_defs::out, L)/" << depth << R"/(_coupled, coupled_in_port>
+using TOP_ics=std::tuple<)/";
+    //the events are sent to every input port of the last level
+    for (unsigned int port = 0; port < coupled_input_ports(topology.kind); port++) {
+        os << (port > 0 ? "," : "") << R"/(
+cadmium::modeling::IC<configured_event_reader, devstone_event_reader_defs::out, L)/" << topology.depth << "_coupled, " << port_name(port == 0 ? coupled_in1 : coupled_in2) << ">";
+    }
+    os << R"/(
 >;
 template<typename TIME>
 using TOP_coupled=cadmium::modeling::coupled_model<TIME, TOP_coupled_in_ports, TOP_coupled_out_ports, TOP_submodels, TOP_eics, TOP_eocs, TOP_ics>;
@@ -172,7 +350,7 @@ using TOP_coupled=cadmium::modeling::coupled_model<TIME, TOP_coupled_in_ports, T
     return os;
 }
 
-ostream& generate_main(bool log_all, ostream& os){
+source_writer& generate_main(bool log_all, parameters_mode parameters, source_writer& os){
     if (log_all){
         os << R"/("
         //LOG state changes TO COUT
@@ -190,7 +368,14 @@ ostream& generate_main(bool log_all, ostream& os){
     os << R"/(
 using hclock=std::chrono::high_resolution_clock; //for measuring execution time
 
-int main(){
+int main(int argc, char* argv[]){
+    select_allocator(argc, argv); //--allocator=system, pool or arena
+)/";
+    if (parameters == runtime_parameters_mode) {
+        os << R"/(    if (!parse_runtime_parameters(argc, argv, generated_defaults)) return 1; //--time-advance, --ext-cycles, --int-cycles, --kernel, --kernel-buffer-kb and --event-list
+)/";
+    }
+    os << R"/(    start_allocation_phase(initialization_phase); //the models are constructed at compile time
     auto start = hclock::now(); //to measure simulation execution time
 )/";
     if ( log_all ) {
@@ -201,11 +386,13 @@ int main(){
         )/";
     }
     os << R"/(
+    start_allocation_phase(simulation_phase);
     r.run_until_passivate();
     
     auto elapsed = std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>
     (hclock::now() - start).count();
     std::cout << "Simulation took:" << elapsed << "sec" << std::endl;
+    print_allocation_stats(std::cout);
     return 0;
 }
 )/";
@@ -219,16 +406,18 @@ int main(int argc, char* argv[]){
     po::options_description desc("Allowed options");
     desc.add_options()
     ("help", "produce help message")
-    ("kind", po::value<string>()->required(), "set kind of devstone: LI, HI or HO")
+    ("kind", po::value<string>()->required(), "set kind of devstone: LI, HI, HO or HOmod")
     ("width", po::value<int>()->required(), "set width of the DEVStone: integer value")
     ("depth", po::value<int>()->required(), "set depth of the DEVStone: integer value")
-    ("int-cycles", po::value<int>()->required(), "set the Dhrystone cycles to expend in internal transtions: integer value")
-    ("ext-cycles", po::value<int>()->required(), "set the Dhrystone cycles to expend in external transtions: integer value")
     ("event-list", po::value<string>()->required(), "set the file to read the events. The format is 2 ints per line meaning time->msg")
     ("time-advance", po::value<int>()->default_value(1), "set the time expend in external transtions by the Dhrystone in miliseconds: integer value")
     ("output", po::value<string>()->required(), "set the name of the file to save the generated model")
     ("logger", po::value<string>()->default_value("default"), "set the logger to use. Options: all, default")
+    ("emission", po::value<string>()->default_value("nested"), "set how the levels are emitted: nested, a coupled model per level nested in the next one, or flat, every atomic in the coupled model of the last level with direct couplings")
+    ("parameters", po::value<string>()->default_value("compiled"), "set how the workload parameters and the event list are given: compiled, in the generated source, runtime, from the command line of the generated model with the generation values as defaults, or constant, as template arguments of the atomics")
     ;
+    add_transition_cost_options(desc);
+    add_workload_options(desc);
     
     po::variables_map vm;
     try {
@@ -245,9 +434,30 @@ int main(int argc, char* argv[]){
             return 1;
         }
     }
+    if (!transition_costs_are_valid(vm)) {
+        cout << "Each transition needs its cost either in cycles or in ns: --int-cycles or --int-ns, and --ext-cycles or --ext-ns" << endl;
+        cout << endl;
+        cout << "for mode information run: " << argv[0] << " --help" << endl;
+        return 1;
+    }
     string kind = vm["kind"].as<string>();
-    if (kind.compare("LI") != 0  && kind.compare("HI") != 0 && kind.compare("HO") != 0) {
-        cout << "The kind needs to be LI, HI or HO and received value was: " << kind;
+    devstone_kind topology_kind;
+    if (!(istringstream(kind) >> topology_kind)) {
+        cout << "The kind needs to be LI, HI, HO or HOmod and received value was: " << kind;
+        cout << endl;
+        cout << "for mode information run: " << argv[0] << " --help" << endl;
+        return 1;
+    }
+    string parameters = vm["parameters"].as<string>();
+    if (parameters != "compiled" && parameters != "runtime" && parameters != "constant") {
+        cout << "The parameters need to be compiled, runtime or constant and received value was: " << parameters;
+        cout << endl;
+        cout << "for mode information run: " << argv[0] << " --help" << endl;
+        return 1;
+    }
+    string emission = vm["emission"].as<string>();
+    if (emission != "nested" && emission != "flat") {
+        cout << "The emission needs to be nested or flat and received value was: " << emission;
         cout << endl;
         cout << "for mode information run: " << argv[0] << " --help" << endl;
         return 1;
@@ -271,51 +481,86 @@ int main(int argc, char* argv[]){
         }
     }
     
+    //nanosecond budgets are translated to cycles in the host generating the model
+    workload work = selected_workload(vm);
+    double ns_per_cycle = 0;
+    if (transition_costs_need_calibration(vm)) {
+        ns_per_cycle = workload_ns_per_cycle(work, vm["calibration-file"].as<string>());
+    }
+
     int width = vm["width"].as<int>();
     int depth = vm["depth"].as<int>();
-    int int_cycles = vm["int-cycles"].as<int>();
-    int ext_cycles = vm["ext-cycles"].as<int>();
+    int int_cycles = transition_cycles(vm, "int", ns_per_cycle);
+    int ext_cycles = transition_cycles(vm, "ext", ns_per_cycle);
     int time_advance = vm["time-advance"].as<int>();
     string event_list = vm["event-list"].as<string>();
     string output = vm["output"].as<string>();
+    if (int_cycles < 0 || ext_cycles < 0 || time_advance < 0) {
+        cout << "The cycles of the transitions and the time advance can not be negative" << endl;
+        cout << endl;
+        cout << "for mode information run: " << argv[0] << " --help" << endl;
+        return 1;
+    }
     bool log_all = (vm["logger"].as<string>() == "default"?false:true);
+    parameters_mode parameters_given = compiled_parameters;
+    if (parameters == "runtime") parameters_given = runtime_parameters_mode;
+    if (parameters == "constant") parameters_given = constant_parameters;
     //finished processing input
     
     auto processed_parameters = hclock::now();
 
-    //create models for LI kind
-    int models_quantity = (width - 1) * (depth - 1) + 1;
+    devstone_topology topology = make_devstone_topology(topology_kind, width, depth);
+    int models_quantity = topology.atomics.size();
+    uint64_t bytes_generated = 0;
     {
-        std::ofstream ofs(output);
-        if (!ofs.good()) {
-            throw runtime_error("Couldn't open file to output generated model");
-        }
+        source_writer ofs(output);
         ofs << header;
-        configure_atomic(int_cycles, ext_cycles, time_advance, ofs);
+        generate_ports(topology, ofs);
+        if (parameters_given == runtime_parameters_mode) {
+            configure_runtime_parameters(int_cycles, ext_cycles, time_advance, work, event_list, ofs);
+        } else if (parameters_given == constant_parameters) {
+            configure_constant_atomic(int_cycles, ext_cycles, time_advance, work, ofs);
+            configure_event_reader(event_list, ofs);
+        } else {
+            configure_atomic(int_cycles, ext_cycles, time_advance, work, ofs);
+            configure_event_reader(event_list, ofs);
+        }
         ofs << "//This model is " << kind << " devstone W=" << width <<", D=" << depth;
         ofs << level_0;
-        for (int l=1; l < depth; l++) {
-            generate_level(l, width, ofs);
+        if (emission == "flat") {
+            generate_flat_levels(flatten_devstone_topology(topology), ofs);
+        } else {
+            generate_levels(topology, ofs);
         }
-        generate_top_models(depth, width, ofs);
-        generate_main(log_all, ofs);
+        generate_top_models(topology, ofs);
+        generate_main(log_all, parameters_given, ofs);
+        ofs.close();
+        bytes_generated = ofs.bytes();
     }
     
     auto model_generated = hclock::now();
 
     cout << "Simulation with params: ";
 
-    cout << "kind: LI ";
+    cout << "kind: " << kind << " ";
     cout << "width: " << width << " ";
     cout << "depth: " << depth << " ";
     cout << "external: " << ext_cycles << " ";
     cout << "internal: " << int_cycles << " ";
-    cout << "logger: " << (log_all?"ALL":"default");
+    cout << "kernel: " << work.kernel << " ";
+    cout << "logger: " << (log_all?"ALL":"default") << " ";
+    cout << "parameters: " << parameters << " ";
+    cout << "emission: " << emission;
     cout << endl;
+    if (ns_per_cycle > 0) {
+        cout << "kernel calibration: " << ns_per_cycle << "ns per cycle" << endl;
+    }
 
     cout << "theory atomic models created: " << models_quantity << std::endl;
     cout << "time processing arguments: " << chrono::duration_cast<chrono::duration<double, ratio<1>>>( processed_parameters - start).count() << endl;
     cout << "time constructing the models: " << chrono::duration_cast<chrono::duration<double, ratio<1>>>( model_generated - processed_parameters).count() << endl;
+    double generation_seconds = chrono::duration_cast<chrono::duration<double, ratio<1>>>( model_generated - processed_parameters).count();
+    cout << "bytes generated: " << bytes_generated << " throughput (MB/s): " << (generation_seconds > 0 ? bytes_generated / generation_seconds / 1e6 : 0) << endl;
     cout << "total time: " << chrono::duration_cast<chrono::duration<double, ratio<1>>>( model_generated - start).count() << endl;
     return 0;
 }
@@ -27,23 +27,61 @@
 #include <chrono>
 #include <algorithm>
 #include <fstream>
+#include <limits>
+#include <memory>
 
 #include <boost/program_options.hpp>
 
 #include <cadmium/engine/pdevs_dynamic_runner.hpp>
 
 #include "helpers.hpp"
+#include "topology-binary.hpp"
+#include "heap-layout.hpp"
+#include "allocation-layer.hpp"
+#include "workload-calibration.hpp"
 #include "dynamic/LI_generator.cpp"
 #include "dynamic/HI_generator.cpp"
 #include "dynamic/HO_generator.cpp"
 #include "dynamic/HOmod_generator.cpp"
+#include "dynamic/sweep.hpp"
+#include "dynamic/flatten.hpp"
 
 namespace po=boost::program_options;
 using hclock=std::chrono::high_resolution_clock;
 using Time=float;
 
+// Prints the value of every option
+void print_params(const po::variables_map& vm){
+    for (const auto& it : vm) {
+        std::cout << it.first.c_str() << ": ";
+        auto& value = it.second.value();
+        if (auto v = boost::any_cast<int>(&value))
+            std::cout << *v;
+        else if (auto v = boost::any_cast<std::string>(&value))
+            std::cout << *v;
+        else if (auto v = boost::any_cast<workload_kernel>(&value))
+            std::cout << *v;
+        else if (auto v = boost::any_cast<event_pattern>(&value))
+            std::cout << *v;
+        else if (auto v = boost::any_cast<heap_layout>(&value))
+            std::cout << *v;
+        else if (auto v = boost::any_cast<allocator_strategy>(&value))
+            std::cout << *v;
+        else if (auto v = boost::any_cast<double>(&value))
+            std::cout << *v;
+        else if (auto v = boost::any_cast<bool>(&value))
+            std::cout << (*v ? "yes" : "no");
+        else if (auto v = boost::any_cast<std::vector<std::string>>(&value))
+            for (const auto& s : *v) std::cout << s << (&s != &v->back() ? "," : "");
+        else
+            std::cout << "error";
+        std::cout << " ";
+    }
+}
+
 int main(int argc, char* argv[]){
     auto start = hclock::now();
+    select_allocator(argc, argv);
 
     // Declare the supported options.
     po::options_description desc("Allowed options");
@@ -52,10 +90,33 @@ int main(int argc, char* argv[]){
             ("kind", po::value<devstone_kind>()->required(), "set kind of devstone: LI, HI, HO or HOmod")
             ("width", po::value<int>()->required(), "set width of the DEVStone: integer value")
             ("depth", po::value<int>()->required(), "set depth of the DEVStone: integer value")
-            ("int-cycles", po::value<int>()->required(), "set the Dhrystone cycles to expend in internal transtions: integer value")
-            ("ext-cycles", po::value<int>()->required(), "set the Dhrystone cycles to expend in external transtions: integer value")
             ("time-advance", po::value<int>()->default_value(1), "set the time expend in external transtions by the Dhrystone in miliseconds: integer value")
+            ("event-list", po::value<std::vector<std::string>>()->multitoken()->composing()->default_value({"events.txt"}, "events.txt"), "set the files to read the events, text or binary. The text format is 2 ints per line meaning time->msg")
+            ("readers", po::value<int>()->default_value(1), "set the number of independent event readers coupled to the model, they take the event lists in turns: integer value")
+            ("prefetch", po::value<int>()->default_value(0), "set the batches of events parsed ahead in a background thread by each reader of a text list, 0 reads them in the transitions: integer value")
+            ("generators", po::value<int>()->default_value(0), "set the number of synthetic event generators coupled to the model, no reader is used unless --readers is given: integer value")
+            ("pattern", po::value<event_pattern>()->default_value(periodic_pattern), "set the arrival pattern of the generators: periodic, poisson, bursty or pareto")
+            ("period", po::value<double>()->default_value(1.0), "set the mean time between events sent by a generator: real value")
+            ("burst-size", po::value<int>()->default_value(10), "set the events sent at once by the bursty pattern: integer value")
+            ("pareto-shape", po::value<double>()->default_value(1.5), "set the shape of the pareto inter-arrivals, greater than 1: real value")
+            ("events", po::value<int>()->default_value(0), "set the events sent by each generator, 0 never stops: integer value")
+            ("seed", po::value<int>()->default_value(1), "set the seed of the first generator, the next ones use the following seeds: integer value")
+            ("stop-time", po::value<double>(), "set the simulation time to stop at, required by generators that never stop: real value")
+            ("build-threads", po::value<int>()->default_value(1), "set the threads used to construct the models, 0 uses one per hardware thread: integer value")
+            ("sweep", po::bool_switch(), "simulate every width from --min-width to --width and depth from --min-depth to --depth, growing the models one level at a time")
+            ("min-width", po::value<int>()->default_value(2), "set the first width of a sweep: integer value")
+            ("min-depth", po::value<int>()->default_value(2), "set the first depth of a sweep: integer value")
+            ("flatten", po::bool_switch(), "simulate a single level model with direct couplings between atomics, equivalent to the DEVStone hierarchy")
+            ("topology", po::bool_switch(), "construct the models translating the topology representation shared with the other simulators, timing both steps")
+            ("allocator", po::value<allocator_strategy>()->default_value(system_allocator), "set the allocator of every new and delete: system, pool or arena, which never frees")
+            ("huge-pages", po::bool_switch(), "back the memory of the pool and arena allocators with 2 MB transparent huge pages")
+            ("allocation-stats", po::bool_switch(), "count and print the allocations, bytes and peak live bytes of each phase")
+            ("heap-layout", po::value<heap_layout>()->default_value(system_heap), "set the placement of the atomics in memory: system, depth-first, breadth-first or scattered. All but system construct the models from the topology representation")
+            ("save-topology", po::value<std::string>(), "construct the models from the topology representation and save it to a binary snapshot file")
+            ("load-topology", po::value<std::string>(), "construct the models from a topology snapshot saved with --save-topology, of the same kind, width and depth, instead of building it")
             ;
+    add_transition_cost_options(desc);
+    add_workload_options(desc);
 
     po::variables_map vm;
     try {
@@ -73,63 +134,253 @@ int main(int argc, char* argv[]){
         }
     }
 
+    if (vm["huge-pages"].as<bool>() && (vm["allocator"].as<allocator_strategy>() == system_allocator || !huge_pages_enabled())) {
+        std::cout << "Huge pages need the pool or arena allocator, and transparent huge pages enabled for madvise in the kernel" << std::endl;
+        std::cout << std::endl;
+        std::cout << "for mode information run: " << argv[0] << " --help" << std::endl;
+        return 1;
+    }
+
+    if (!transition_costs_are_valid(vm)) {
+        std::cout << "Each transition needs its cost either in cycles or in ns: --int-cycles or --int-ns, and --ext-cycles or --ext-ns" << std::endl;
+        std::cout << std::endl;
+        std::cout << "for mode information run: " << argv[0] << " --help" << std::endl;
+        return 1;
+    }
+
+    if (vm["generators"].as<int>() > 0 && vm["events"].as<int>() <= 0 && !vm.count("stop-time")) {
+        std::cout << "Generators that never stop need a simulation stop time: --events or --stop-time" << std::endl;
+        std::cout << std::endl;
+        std::cout << "for mode information run: " << argv[0] << " --help" << std::endl;
+        return 1;
+    }
+
+    if (vm["generators"].as<int>() > 0 && !(vm["period"].as<double>() > 0)) {
+        std::cout << "The mean time between generated events, --period, has to be greater than 0" << std::endl;
+        std::cout << std::endl;
+        std::cout << "for mode information run: " << argv[0] << " --help" << std::endl;
+        return 1;
+    }
+
+    if (vm["generators"].as<int>() > 0 && vm["pattern"].as<event_pattern>() == pareto_pattern && !(vm["pareto-shape"].as<double>() > 1)) {
+        std::cout << "The pareto shape, --pareto-shape, has to be greater than 1 for the mean time between events to exist" << std::endl;
+        std::cout << std::endl;
+        std::cout << "for mode information run: " << argv[0] << " --help" << std::endl;
+        return 1;
+    }
+
+    bool topology_construction = vm["topology"].as<bool>() || vm["heap-layout"].as<heap_layout>() != system_heap
+                                 || vm.count("save-topology") || vm.count("load-topology");
+    if (!vm["build-threads"].defaulted() && (vm["heap-layout"].as<heap_layout>() != system_heap || vm["sweep"].as<bool>())) {
+        std::cout << "The atomics of a heap layout are placed in order and sweeps grow the models one level at a time, --build-threads can not be used with --heap-layout or --sweep" << std::endl;
+        std::cout << std::endl;
+        std::cout << "for mode information run: " << argv[0] << " --help" << std::endl;
+        return 1;
+    }
+
+    if (vm["sweep"].as<bool>() && (topology_construction || vm["flatten"].as<bool>())) {
+        std::cout << "Sweeps grow the models from the topology themselves, --sweep can not be used with --flatten, --topology, --heap-layout, --save-topology or --load-topology" << std::endl;
+        std::cout << std::endl;
+        std::cout << "for mode information run: " << argv[0] << " --help" << std::endl;
+        return 1;
+    }
+
+    workload work = selected_workload(vm);
+    double ns_per_cycle = 0;
+    if (transition_costs_need_calibration(vm)) {
+        ns_per_cycle = workload_ns_per_cycle(work, vm["calibration-file"].as<std::string>());
+    }
+
     int width = vm["width"].as<int>();
     int depth = vm["depth"].as<int>();
-    int int_cycles = vm["int-cycles"].as<int>();
-    int ext_cycles = vm["ext-cycles"].as<int>();
+    int int_cycles = transition_cycles(vm, "int", ns_per_cycle);
+    int ext_cycles = transition_cycles(vm, "ext", ns_per_cycle);
     int time_advance = vm["time-advance"].as<int>();
     devstone_kind kind = vm["kind"].as<devstone_kind>();
+    event_inputs inputs;
+    inputs.event_lists = vm["event-list"].as<std::vector<std::string>>();
+    inputs.prefetch_batches = static_cast<std::size_t>(std::max(vm["prefetch"].as<int>(), 0));
+    inputs.generators = static_cast<unsigned int>(std::max(vm["generators"].as<int>(), 0));
+    //generators replace the reader, unless readers are explicitly requested too
+    int readers = (inputs.generators > 0 && vm["readers"].defaulted() ? 0 : vm["readers"].as<int>());
+    inputs.readers = static_cast<unsigned int>(std::max(readers, inputs.generators > 0 ? 0 : 1));
+    inputs.generator.pattern = vm["pattern"].as<event_pattern>();
+    inputs.generator.period = vm["period"].as<double>();
+    inputs.generator.burst_size = static_cast<unsigned int>(std::max(vm["burst-size"].as<int>(), 1));
+    inputs.generator.pareto_shape = vm["pareto-shape"].as<double>();
+    inputs.generator.events = static_cast<std::uint64_t>(std::max(vm["events"].as<int>(), 0));
+    inputs.generator.seed = static_cast<std::uint64_t>(vm["seed"].as<int>());
+    unsigned int build_threads = build_threads_for(static_cast<unsigned int>(std::max(vm["build-threads"].as<int>(), 0)));
     //finished processing input
 
+    if (vm["sweep"].as<bool>()) {
+        devstone_sweep sweep;
+        sweep.min_width = static_cast<unsigned int>(std::max(vm["min-width"].as<int>(), 1));
+        sweep.max_width = static_cast<unsigned int>(std::max(width, 1));
+        sweep.min_depth = static_cast<unsigned int>(std::max(vm["min-depth"].as<int>(), 1));
+        sweep.max_depth = static_cast<unsigned int>(std::max(depth, 1));
+        double stop_time = (vm.count("stop-time") ? vm["stop-time"].as<double>() : std::numeric_limits<double>::infinity());
+        auto make_atomic_devstone = [&](const std::string& model_id) -> std::shared_ptr<cadmium::dynamic::modeling::model> {
+            return cadmium::dynamic::translate::make_dynamic_atomic_model<devstone_atomic, TIME>(model_id, ext_cycles, int_cycles, Time(time_advance), work);
+        };
+
+        std::cout << "Sweep with params: ";
+        print_params(vm);
+        std::cout << std::endl;
+        switch(kind) {
+            case LI:
+                run_devstone_sweep<TIME, LI_topology_ports, coupledLI_in_port>(kind, sweep, make_atomic_devstone, inputs, stop_time, std::cout);
+                break;
+            case HI:
+                run_devstone_sweep<TIME, HI_topology_ports, coupledHI_in_port>(kind, sweep, make_atomic_devstone, inputs, stop_time, std::cout);
+                break;
+            case HO:
+                run_devstone_sweep<TIME, HO_topology_ports, coupledHO_in_port1, coupledHO_in_port2>(kind, sweep, make_atomic_devstone, inputs, stop_time, std::cout);
+                break;
+            case HOmod:
+                run_devstone_sweep<TIME, HOmod_topology_ports, coupledHOmod_in_port1, coupledHOmod_in_port2>(kind, sweep, make_atomic_devstone, inputs, stop_time, std::cout);
+                break;
+            default:
+                abort();
+        }
+        std::cout << "total time: " << std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>( hclock::now() - start).count() << std::endl;
+        print_allocation_stats(std::cout);
+        return 0;
+    }
+
     auto processed_parameters = hclock::now();
+    long processed_parameters_rss_kb = current_rss_kb();
+    start_allocation_phase(construction_phase);
 
     std::shared_ptr<cadmium::dynamic::modeling::coupled<Time>> TOP_coupled;
-    switch(kind) {
-        case LI:
-            TOP_coupled = create_LI_model(width,depth, ext_cycles, int_cycles, time_advance);
-            break;
-        case HI:
-            TOP_coupled = create_HI_model(width, depth, ext_cycles, int_cycles, time_advance);
-            break;
-        case HO:
-            TOP_coupled = create_HO_model(width,depth, ext_cycles, int_cycles, time_advance);
-            break;
-        case HOmod:
-            TOP_coupled = create_HOmod_model(width,depth, ext_cycles, int_cycles, time_advance);
-            break;
-        default:
-            abort();
+    bool load_topology = vm.count("load-topology");
+    bool save_topology = vm.count("save-topology");
+    heap_layout layout = vm["heap-layout"].as<heap_layout>();
+    std::shared_ptr<atomic_heap> heap;
+    bool from_topology = topology_construction;
+    auto topology_built = processed_parameters;
+    auto topology_saved = processed_parameters;
+    if (from_topology) {
+        //snapshots are translated from the mapped records, built topologies from their arrays
+        devstone_topology built_topology;
+        std::unique_ptr<mapped_devstone_topology> mapped_topology;
+        if (load_topology) {
+            mapped_topology = std::make_unique<mapped_devstone_topology>(vm["load-topology"].as<std::string>());
+            const topology_view& loaded = mapped_topology->view();
+            if (loaded.kind != kind || loaded.width != static_cast<unsigned int>(width) || loaded.depth != static_cast<unsigned int>(depth)) {
+                std::cout << "The topology snapshot " << vm["load-topology"].as<std::string>() << " is not of the --kind, --width and --depth given" << std::endl;
+                std::cout << std::endl;
+                std::cout << "for mode information run: " << argv[0] << " --help" << std::endl;
+                return 1;
+            }
+        } else {
+            built_topology = make_devstone_topology(kind, width, depth);
+        }
+        topology_view topology = (mapped_topology ? mapped_topology->view() : topology_view(built_topology));
+        topology_built = hclock::now();
+        if (save_topology) {
+            save_devstone_topology(topology, vm["save-topology"].as<std::string>());
+        }
+        topology_saved = hclock::now();
+        if (layout != system_heap) {
+            heap = std::make_shared<atomic_heap>(layout, topology);
+        }
+        switch(kind) {
+            case LI:
+                TOP_coupled = create_LI_model_from_topology(topology, ext_cycles, int_cycles, time_advance, work, inputs, heap, build_threads);
+                break;
+            case HI:
+                TOP_coupled = create_HI_model_from_topology(topology, ext_cycles, int_cycles, time_advance, work, inputs, heap, build_threads);
+                break;
+            case HO:
+                TOP_coupled = create_HO_model_from_topology(topology, ext_cycles, int_cycles, time_advance, work, inputs, heap, build_threads);
+                break;
+            case HOmod:
+                TOP_coupled = create_HOmod_model_from_topology(topology, ext_cycles, int_cycles, time_advance, work, inputs, heap, build_threads);
+                break;
+            default:
+                abort();
+        }
+    } else {
+        switch(kind) {
+            case LI:
+                TOP_coupled = create_LI_model(width,depth, ext_cycles, int_cycles, time_advance, work, inputs, build_threads);
+                break;
+            case HI:
+                TOP_coupled = create_HI_model(width, depth, ext_cycles, int_cycles, time_advance, work, inputs, build_threads);
+                break;
+            case HO:
+                TOP_coupled = create_HO_model(width,depth, ext_cycles, int_cycles, time_advance, work, inputs, build_threads);
+                break;
+            case HOmod:
+                TOP_coupled = create_HOmod_model(width,depth, ext_cycles, int_cycles, time_advance, work, inputs, build_threads);
+                break;
+            default:
+                abort();
+        }
+    }
+
+    auto hierarchy_built = hclock::now();
+    bool flatten = vm["flatten"].as<bool>();
+    if (flatten) {
+        TOP_coupled = flatten_hierarchy<TIME>(TOP_coupled);
     }
 
     auto model_built = hclock::now();
+    long model_built_rss_kb = current_rss_kb();
+    start_allocation_phase(initialization_phase);
 
     cadmium::dynamic::engine::runner<TIME, cadmium::logger::not_logger> r(TOP_coupled, 0.0);
 
     auto model_init = hclock::now();
+    start_allocation_phase(simulation_phase);
 
-    r.run_until_passivate();
+    if (vm.count("stop-time")) {
+        r.run_until(vm["stop-time"].as<double>());
+    } else {
+        r.run_until_passivate();
+    }
 
     auto finished_simulation = hclock::now();
+    start_allocation_phase(reporting_phase);
 
     std::cout << "Simulation with params: ";
 
-    for (const auto& it : vm) {
-        std::cout << it.first.c_str() << ": ";
-        auto& value = it.second.value();
-        if (auto v = boost::any_cast<int>(&value))
-            std::cout << *v;
-        else if (auto v = boost::any_cast<std::string>(&value))
-            std::cout << *v;
-        else
-            std::cout << "error";
-        std::cout << " ";
-    }
+    print_params(vm);
 
 
     std::cout << std::endl;
+    std::cout << "kernel: " << work.kernel << " buffer: " << work.buffer_bytes << " bytes" << std::endl;
+    if (ns_per_cycle > 0) {
+        std::cout << "kernel calibration: " << ns_per_cycle << "ns per cycle, internal cycles: " << int_cycles << " external cycles: " << ext_cycles << std::endl;
+    }
     std::cout << "time processing arguments: " << std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>( processed_parameters - start).count() << std::endl;
-    std::cout << "time constructing the models: " << std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>( model_built - processed_parameters).count() << std::endl;
+    //saving the topology is not part of the construction
+    std::cout << "time constructing the models: " << std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>( hierarchy_built - processed_parameters - (topology_saved - topology_built)).count() << std::endl;
+    if (from_topology) {
+        std::cout << (load_topology ? "time loading the topology: " : "time building the topology: ") << std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>( topology_built - processed_parameters).count() << std::endl;
+        if (save_topology) {
+            std::cout << "time saving the topology: " << std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>( topology_saved - topology_built).count() << std::endl;
+        }
+        std::cout << "time translating the topology: " << std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>( hierarchy_built - topology_saved).count() << std::endl;
+    }
+    std::cout << "threads constructing the models: " << (heap ? 1 : build_threads) << std::endl;
+    if (flatten) {
+        std::cout << "time flattening the models: " << std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>( model_built - hierarchy_built).count() << std::endl;
+        std::cout << "couplings after flattening: " << TOP_coupled->_ic.size() << std::endl;
+    }
+    unsigned long atomics = devstone_atomics(kind, width, depth);
+    std::cout << "atomics: " << atomics << std::endl;
+    std::cout << "RSS after constructing the models (KB): " << model_built_rss_kb << std::endl;
+    std::cout << "bytes per atomic constructed: " << (model_built_rss_kb - processed_parameters_rss_kb) * 1024.0 / atomics << std::endl;
+    std::cout << "peak RSS (KB): " << peak_rss_kb() << std::endl;
     std::cout << "time initializing the models: " << std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>( model_init - model_built).count() << std::endl;
+    std::cout << "heap layout: " << layout;
+    if (heap) {
+        std::cout << " arena: " << heap->arena_bytes() << " bytes";
+    }
+    std::cout << std::endl;
     std::cout << "time running simulation: " << std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>( finished_simulation - model_init).count() << std::endl;
     std::cout << "total time: " << std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>( finished_simulation - start).count() << std::endl;
+    print_allocation_stats(std::cout);
 }
@@ -0,0 +1,196 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CADMIUM_EVENT_GENERATOR_HPP
+#define CADMIUM_EVENT_GENERATOR_HPP
+
+#include<cadmium/modeling/ports.hpp>
+#include<cadmium/modeling/message_bag.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Synthetic event sources, an alternative to reading the events from a file.
+ *
+ * - periodic: one event every period.
+ * - poisson: exponential inter-arrivals with mean period.
+ * - bursty: on/off source, bursts of burst_size events at a single timestamp separated by
+ *   exponential off times, keeping a mean of one event every period.
+ * - pareto: heavy-tailed inter-arrivals with the given shape (> 1), scaled to a mean of period.
+ *
+ * Events carry consecutive integers starting at 1, as the events.txt lists do.
+ * The generator stops after the configured amount of events, or never when it is 0.
+ * Generators built with the same configuration produce the same stream.
+ */
+
+enum event_pattern {periodic_pattern, poisson_pattern, bursty_pattern, pareto_pattern};
+
+std::istream& operator>>(std::istream& in, event_pattern& pattern) {
+    std::string input;
+    in >> input;
+    if (input == "periodic") {
+        pattern = periodic_pattern;
+    } else if (input == "poisson") {
+        pattern = poisson_pattern;
+    } else if (input == "bursty") {
+        pattern = bursty_pattern;
+    } else if (input == "pareto") {
+        pattern = pareto_pattern;
+    } else {
+        in.setstate(std::ios_base::failbit);
+    }
+    return in;
+}
+
+std::ostream& operator<<(std::ostream& os, const event_pattern& pattern) {
+    switch (pattern) {
+        case periodic_pattern: return os << "periodic";
+        case poisson_pattern: return os << "poisson";
+        case bursty_pattern: return os << "bursty";
+        case pareto_pattern: return os << "pareto";
+    }
+    return os;
+}
+
+struct event_generator_config {
+    event_pattern pattern = periodic_pattern;
+    double period = 1.0; //mean time between events
+    unsigned int burst_size = 10; //events sent at the same time by the bursty pattern
+    double pareto_shape = 1.5;
+    std::uint64_t events = 0; //events to send, 0 never stops
+    std::uint64_t seed = 1;
+};
+
+//  an integer output port for the model
+struct devstone_event_generator_defs{
+    //custom ports
+    struct in : public cadmium::in_port<int> {};
+    struct out : public cadmium::out_port<int> {};
+};
+
+template<typename TIME>
+class devstone_event_generator {
+public:
+    using defs=devstone_event_generator_defs;
+
+    // state is the amount of events sent
+    using state_type=std::uint64_t;
+    state_type state = 0;
+
+    // ports definition
+    using input_ports=std::tuple<>;
+    using output_ports=std::tuple<typename defs::out>;
+    using outbag_t=typename cadmium::make_message_bags<output_ports>::type;
+    outbag_t outbag;
+
+    event_generator_config config;
+    std::mt19937_64 random;
+    double last = 0; //times are accumulated in double, TIME may be too narrow for long runs
+    double next = 0;
+
+    devstone_event_generator() : devstone_event_generator(event_generator_config()) {}
+
+    explicit devstone_event_generator(const event_generator_config& generator_config)
+    : config(generator_config), random(generator_config.seed) {
+        if (!(config.period > 0.0)) {
+            throw std::runtime_error("the period of the generated events has to be greater than 0");
+        }
+        if (config.pattern == pareto_pattern && !(config.pareto_shape > 1.0)) {
+            throw std::runtime_error("the pareto shape has to be greater than 1 for the inter-arrival mean to exist");
+        }
+        if (config.burst_size == 0) config.burst_size = 1;
+        next = inter_arrival();
+        prepare_output();
+    }
+
+    void internal_transition() {
+        state += cadmium::get_messages<typename defs::out>(outbag).size();
+        last = next;
+        if (config.events != 0 && state >= config.events) {
+            next = std::numeric_limits<double>::infinity();
+        } else {
+            next += inter_arrival();
+            prepare_output();
+        }
+    }
+
+    void external_transition(TIME e, typename cadmium::make_message_bags<input_ports>::type mbs) {
+        assert(false && "Non external input is expected in this model");
+    }
+
+    void confluence_transition(TIME e, typename cadmium::make_message_bags<input_ports>::type mbs) {
+        assert(false && "Non external input is expected in this model");
+    }
+
+    outbag_t output() const {
+        return outbag;
+    }
+
+    TIME time_advance() const {
+        if (next == std::numeric_limits<double>::infinity()) return std::numeric_limits<TIME>::infinity();
+        return static_cast<TIME>(next) - static_cast<TIME>(last);
+    }
+
+private:
+    //time from the last arrival to the next one
+    double inter_arrival() {
+        switch (config.pattern) {
+            case periodic_pattern:
+                return config.period;
+            case poisson_pattern:
+                return std::exponential_distribution<double>(1.0 / config.period)(random);
+            case bursty_pattern:
+                return std::exponential_distribution<double>(1.0 / (config.period * config.burst_size))(random);
+            case pareto_pattern: {
+                //inverse transform sampling, the scale sets the mean to the period
+                double scale = config.period * (config.pareto_shape - 1.0) / config.pareto_shape;
+                double u = std::uniform_real_distribution<double>(0.0, 1.0)(random);
+                return scale / std::pow(1.0 - u, 1.0 / config.pareto_shape);
+            }
+        }
+        return config.period;
+    }
+
+    //the messages sent at the next arrival
+    void prepare_output() {
+        auto& messages = cadmium::get_messages<typename defs::out>(outbag);
+        messages.clear();
+        std::uint64_t amount = (config.pattern == bursty_pattern ? config.burst_size : 1);
+        if (config.events != 0) amount = std::min(amount, config.events - state);
+        for (std::uint64_t i = 1; i <= amount; i++) {
+            messages.push_back(static_cast<int>(state + i));
+        }
+    }
+};
+
+#endif // CADMIUM_EVENT_GENERATOR_HPP
@@ -31,11 +31,20 @@
 #include<cadmium/modeling/message_bag.hpp>
 #include<limits>
 #include<fstream>
+#include<memory>
 #include <cassert>
+#include <string>
+
+#include "event-list-binary.hpp"
+#include "event-text-parser.hpp"
+#include "event-prefetcher.hpp"
 
 /**
- * Events are read from "events.txt", first column is absolute time the event has to be sent,
- * the second column tells the integer to sent in the "out" port
+ * Events are read from the file given at construction ("events.txt" by default), first column is
+ * absolute time the event has to be sent, the second column tells the integer to sent in the "out" port
+ * The file can also be a binary event list (see event-list-binary.hpp), which is read in place.
+ * Text lists can be parsed ahead by a background thread, keeping up to the given amount of
+ * batches of events ready (see event-prefetcher.hpp).
  */
 
 //  an integer output port for the model
@@ -61,27 +70,44 @@ public:
     using outbag_t=typename cadmium::make_message_bags<output_ports>::type;
     outbag_t outbag;
 
-    std::ifstream is; //the stream
+    std::unique_ptr<event_text_parser> text; //the events, when reading a text event list
+    std::unique_ptr<prefetching_event_parser> prefetched; //the events, when parsing a text event list ahead
+    std::unique_ptr<mapped_event_list> mapped; //the records, when reading a binary event list
+    const event_record* cursor = nullptr; //next record to send, when reading a binary event list
     TIME last;
     TIME next;
-    int prefetched_message;
     
-    // default constructor opens the stream and sets initial time
-    constexpr devstone_event_reader() {
+    // default constructor reads the events from "events.txt"
+    devstone_event_reader() : devstone_event_reader("events.txt") {}
+
+    // opens the stream and sets initial time, prefetch_batches > 0 parses text lists in background
+    explicit devstone_event_reader(const std::string& event_list, std::size_t prefetch_batches = 0) {
         last = 0;
-        is.open("events.txt");
-        if (!is.good()) throw std::runtime_error("failed to open events file: events.txt");
-        is >> next;
-        if (is.eof()){
-             next = std::numeric_limits<float>::infinity();
-        } else {
-            is >> prefetched_message;
+        cadmium::get_messages<typename defs::out>(outbag).reserve(initial_bag_capacity);
+        if (is_binary_event_list(event_list)) {
+            mapped.reset(new mapped_event_list(event_list));
+            cursor = mapped->begin();
+            next = (cursor == mapped->end() ? std::numeric_limits<float>::infinity() : static_cast<TIME>(cursor->time));
+            return;
+        }
+        if (prefetch_batches > 0) {
+            prefetched.reset(new prefetching_event_parser(event_list, prefetch_batches));
+            next = (prefetched->has_next() ? static_cast<TIME>(prefetched->next_time()) : std::numeric_limits<float>::infinity());
+            return;
         }
+        text.reset(new event_text_parser(event_list));
+        next = (text->has_next() ? static_cast<TIME>(text->next_time()) : std::numeric_limits<float>::infinity());
     }
     
     void internal_transition() {
         last = next;
-        fetchUntilTimeAdvances();
+        if (mapped) {
+            fetchMappedUntilTimeAdvances();
+        } else if (prefetched) {
+            fetchPrefetchedUntilTimeAdvances();
+        } else {
+            fetchUntilTimeAdvances();
+        }
     }
     
     void external_transition(TIME e, typename cadmium::make_message_bags<input_ports>::type mbs) {
@@ -102,34 +128,57 @@ public:
     
     
 private:
-    //helper function
+    static constexpr std::size_t initial_bag_capacity = 64;
+
+    //helper function, the parser gathers every event at the next time in one call
     void fetchUntilTimeAdvances() {
-        //making use of the prefetched values
-        cadmium::get_messages<typename defs::out>(outbag) = {prefetched_message};
-        TIME t;
-        int m;
-        //fetching next messages
-        is >> t;
-        if (is.eof()){
+        auto& messages = cadmium::get_messages<typename defs::out>(outbag);
+        messages.clear();
+        //times equal once converted to TIME are sent together
+        do {
+            text->read_batch(messages);
+        } while (text->has_next() && static_cast<TIME>(text->next_time()) == next);
+        if (!text->has_next()) {
             next = std::numeric_limits<float>::infinity();
-            return;
+        } else if (next < static_cast<TIME>(text->next_time())) {
+            next = static_cast<TIME>(text->next_time());
+        } else {
+            throw std::runtime_error("next is before than now");
         }
-        while (!is.eof() && t == next){
-            is >> m;
-            cadmium::get_messages<typename defs::out>(outbag).push_back(m);
-            is >> t;
+    }
+
+    //helper function for lists parsed in background, the batches are already decoded
+    void fetchPrefetchedUntilTimeAdvances() {
+        auto& messages = cadmium::get_messages<typename defs::out>(outbag);
+        prefetched->take_batch(messages);
+        //times equal once converted to TIME are sent together
+        while (prefetched->has_next() && static_cast<TIME>(prefetched->next_time()) == next) {
+            prefetched->append_batch(messages);
         }
-        if (is.eof()){
+        if (!prefetched->has_next()) {
             next = std::numeric_limits<float>::infinity();
-            return;
+        } else if (next < static_cast<TIME>(prefetched->next_time())) {
+            next = static_cast<TIME>(prefetched->next_time());
+        } else {
+            throw std::runtime_error("next is before than now");
+        }
+    }
+
+    //helper function for binary event lists, the records are used in place
+    void fetchMappedUntilTimeAdvances() {
+        auto& messages = cadmium::get_messages<typename defs::out>(outbag);
+        messages.clear();
+        const event_record* end = mapped->end();
+        while (cursor != end && static_cast<TIME>(cursor->time) == next) {
+            messages.push_back(cursor->value);
+            ++cursor;
+        }
+        if (cursor == end) {
+            next = std::numeric_limits<float>::infinity();
+        } else if (next < static_cast<TIME>(cursor->time)) {
+            next = static_cast<TIME>(cursor->time);
         } else {
-            if (next < t) {
-                next = t;
-                //cache the last message fetched
-                is >> prefetched_message;
-            } else {
-                throw std::runtime_error("next is before than now");
-            }
+            throw std::runtime_error("next is before than now");
         }
     }
 
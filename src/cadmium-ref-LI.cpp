@@ -31,6 +31,7 @@
 #include <cadmium/engine/pdevs_runner.hpp>
 #include "cadmium-devstone-atomic.hpp"
 #include "cadmium-event-reader.hpp"
+#include "allocation-layer.hpp"
 
 // Ports for coupled models, we use the same in every level
 struct coupled_in_port : public cadmium::in_port<int>{};
@@ -51,6 +52,12 @@ struct configured_atomic_devstone : devstone_atomic<TIME>{
     }
 };
 
+//The event reader of the model, reading the event list given when the model was generated.
+template<typename TIME>
+struct configured_event_reader : devstone_event_reader<TIME>{
+    configured_event_reader() : devstone_event_reader<TIME>("events.txt"){}
+};
+
 //This model is LI devstone W=3, D=3
 //Level 0 has always a single model
 template<typename TIME>
@@ -62,8 +69,6 @@ template<typename TIME>
 struct devstone_atomic_L1_0 : configured_atomic_devstone<TIME>{};
 template<typename TIME>
 struct devstone_atomic_L1_1 : configured_atomic_devstone<TIME>{};
-template<typename TIME>
-struct devstone_atomic_L1_2 : configured_atomic_devstone<TIME>{};
 //coupled
 using L1_submodels=cadmium::modeling::models_tuple<devstone_atomic_L0_0>;
 using L1_eics=std::tuple<
@@ -81,15 +86,12 @@ template<typename TIME>
 struct devstone_atomic_L2_0 : configured_atomic_devstone<TIME>{};
 template<typename TIME>
 struct devstone_atomic_L2_1 : configured_atomic_devstone<TIME>{};
-template<typename TIME>
-struct devstone_atomic_L2_2 : configured_atomic_devstone<TIME>{};
 //coupled
-using L2_submodels=cadmium::modeling::models_tuple<devstone_atomic_L1_0, devstone_atomic_L1_1, devstone_atomic_L1_2, L1_coupled>;
+using L2_submodels=cadmium::modeling::models_tuple<L1_coupled, devstone_atomic_L1_0, devstone_atomic_L1_1>;
 using L2_eics=std::tuple<
     cadmium::modeling::EIC<coupled_in_port, L1_coupled, coupled_in_port>,
     cadmium::modeling::EIC<coupled_in_port, devstone_atomic_L1_0, devstone_atomic_defs::in>,
-    cadmium::modeling::EIC<coupled_in_port, devstone_atomic_L1_1, devstone_atomic_defs::in>,
-    cadmium::modeling::EIC<coupled_in_port, devstone_atomic_L1_2, devstone_atomic_defs::in>
+    cadmium::modeling::EIC<coupled_in_port, devstone_atomic_L1_1, devstone_atomic_defs::in>
 >;
 using L2_eocs=std::tuple<
     cadmium::modeling::EOC<L1_coupled,coupled_out_port, coupled_out_port>
@@ -99,12 +101,11 @@ using L2_coupled=cadmium::modeling::coupled_model<TIME, coupled_in_ports, couple
 
 //Level 3 has no atomics because it is the last level
 //coupled
-using L3_submodels=cadmium::modeling::models_tuple<devstone_atomic_L2_0, devstone_atomic_L2_1, devstone_atomic_L2_2, L2_coupled>;
+using L3_submodels=cadmium::modeling::models_tuple<L2_coupled, devstone_atomic_L2_0, devstone_atomic_L2_1>;
 using L3_eics=std::tuple<
     cadmium::modeling::EIC<coupled_in_port, L2_coupled, coupled_in_port>,
     cadmium::modeling::EIC<coupled_in_port, devstone_atomic_L2_0, devstone_atomic_defs::in>,
-    cadmium::modeling::EIC<coupled_in_port, devstone_atomic_L2_1, devstone_atomic_defs::in>,
-    cadmium::modeling::EIC<coupled_in_port, devstone_atomic_L2_2, devstone_atomic_defs::in>
+    cadmium::modeling::EIC<coupled_in_port, devstone_atomic_L2_1, devstone_atomic_defs::in>
 >;
 using L3_eocs=std::tuple<
     cadmium::modeling::EOC<L2_coupled,coupled_out_port, coupled_out_port>
@@ -115,26 +116,30 @@ using L3_coupled=cadmium::modeling::coupled_model<TIME, coupled_in_ports, couple
 //TOP model conecting a generator of events to the input
 using TOP_coupled_in_ports=std::tuple<>;
 using TOP_coupled_out_ports=std::tuple<>;
-using TOP_submodels=cadmium::modeling::models_tuple<devstone_event_reader, L3_coupled>;
+using TOP_submodels=cadmium::modeling::models_tuple<configured_event_reader, L3_coupled>;
 using TOP_eics=std::tuple<>;
 using TOP_eocs=std::tuple<>;
 using TOP_ics=std::tuple<
-cadmium::modeling::IC<devstone_event_reader, devstone_event_reader_defs::out, L3_coupled, coupled_in_port>
+cadmium::modeling::IC<configured_event_reader, devstone_event_reader_defs::out, L3_coupled, coupled_in_port>
 >;
 template<typename TIME>
 using TOP_coupled=cadmium::modeling::coupled_model<TIME, TOP_coupled_in_ports, TOP_coupled_out_ports, TOP_submodels, TOP_eics, TOP_eocs, TOP_ics>;
 
 using hclock=std::chrono::high_resolution_clock; //for measuring execution time
 
-int main(){
+int main(int argc, char* argv[]){
+    select_allocator(argc, argv); //--allocator=system, pool or arena
+    start_allocation_phase(initialization_phase); //the models are constructed at compile time
     auto start = hclock::now(); //to measure simulation execution time
 
     cadmium::engine::runner<float, TOP_coupled, cadmium::logger::not_logger> r{0.0};
 
+    start_allocation_phase(simulation_phase);
     r.run_until_passivate();
 
     auto elapsed = std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>
     (hclock::now() - start).count();
     std::cout << "Simulation took:" << elapsed << "sec" << std::endl;
+    print_allocation_stats(std::cout);
     return 0;
 }
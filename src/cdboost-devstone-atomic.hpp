@@ -27,7 +27,7 @@
 #define P_DEVSTONE_ATOMIC_H
 
 #include <boost/simulation/pdevs/atomic.hpp>
-#include "../dhry/dhry_1.c"
+#include "workload-kernels.hpp"
 
 namespace cdpp {
 /**
@@ -47,6 +47,7 @@ class PDEVStoneAtomic : public boost::simulation::pdevs::atomic<TIME, MSG>
     int _external_cycles;
     TIME _period;
     int _queued_processes;
+    workload _work;
 public:
     /**
      * @brief DEVStoneAtomic constructor.
@@ -54,9 +55,10 @@ public:
      * @param internal_cycles the cycles dhrystone will be run in internal transitions.
      * @param external_cycles the cycles dhrystone will be run in external transitions.
      * @param period the time used for all time_advances.
+     * @param work the kernel run in transitions instead of dhrystone.
      */
-    explicit PDEVStoneAtomic(int internal_cycles, int external_cycles,  TIME period)
-        : _internal_cycles(internal_cycles), _external_cycles(external_cycles), _period(period), _queued_processes(0)
+    explicit PDEVStoneAtomic(int internal_cycles, int external_cycles,  TIME period, workload work=workload())
+        : _internal_cycles(internal_cycles), _external_cycles(external_cycles), _period(period), _queued_processes(0), _work(work)
     {
         _out.push_back(1);
     }
@@ -64,7 +66,7 @@ public:
      * @brief internal function.
      */
     void internal() noexcept {
-        DhryStone().dhrystoneRun(_internal_cycles);
+        run_workload(_work, _internal_cycles);
         _queued_processes--;
     }
     /**
@@ -87,7 +89,7 @@ public:
      * @param t time the external input is received.
      */
     void external(const std::vector<MSG>& msg, const TIME& t) noexcept {
-        DhryStone().dhrystoneRun(_external_cycles);
+        run_workload(_work, _external_cycles);
         _queued_processes+=msg.size();
     }
     /**
@@ -30,6 +30,11 @@
 #include <boost/program_options.hpp>
 #include <boost/simulation.hpp>
 #include "cdboost-devstone-atomic.hpp"
+#include "cdboost-event-reader.hpp"
+#include "workload-calibration.hpp"
+#include "topology.hpp"
+#include "heap-layout.hpp"
+#include "allocation-layer.hpp"
 
 using namespace std;
 using namespace cdpp;
@@ -40,89 +45,63 @@ using Time=double;
 inline bool is_infinity(double& f ){ return isinf(f); }
 using msg_type=int;
 
-shared_ptr<boost::simulation::pdevs::coupled<Time, msg_type>> LI_coupling(int& counted_atomic_models, int& counted_coupled_models,
-                           int width, int depth, string event_list, int ext_cycles, int int_cycles, int time_advance)
-{
-    shared_ptr<boost::simulation::pdevs::coupled<Time, msg_type>> cm;
-    auto first_pdevstone = boost::simulation::make_atomic_ptr<PDEVStoneAtomic<Time, msg_type>, int, int, Time>(int_cycles, ext_cycles, Time(time_advance));
-    counted_atomic_models++;
-    cm.reset(new boost::simulation::pdevs::coupled<Time, msg_type>{{first_pdevstone}, {first_pdevstone}, {}, {first_pdevstone}});
-    counted_coupled_models++;
-
-    //connect higher level models
-
-    for (int i=1; i < depth; i++){
-        vector<std::shared_ptr<boost::simulation::model<Time>>> vpdt;
-        vector<std::shared_ptr<boost::simulation::model<Time>>> eoc_cm;
-        vector<std::shared_ptr<boost::simulation::model<Time>>> eic_cm;
-        vpdt.clear();
-        eoc_cm.clear();
-        eic_cm.clear();
-        eoc_cm.push_back(cm);
-        for (int j=0; j < width-1; j++){
-            auto current = (std::shared_ptr<boost::simulation::model<Time>>) std::make_shared<cdpp::PDEVStoneAtomic<Time, msg_type>>(int_cycles, ext_cycles, Time(time_advance));
-            vpdt.push_back(current);
-            counted_atomic_models++;
-            eic_cm.push_back(current);
-        }
-        vpdt.push_back(cm);
-        eic_cm.push_back(cm);
-
-        shared_ptr<boost::simulation::pdevs::coupled<Time, msg_type>> cm_int ( new boost::simulation::pdevs::coupled<Time, msg_type>{vpdt, eic_cm, {}, eoc_cm});
-        counted_coupled_models++;
-        cm=cm_int;
+//Text event lists are read by the CDBoost input_stream, binary event lists are read in place
+shared_ptr<boost::simulation::model<Time>> make_event_input(const string& event_list){
+    if (is_binary_event_list(event_list)) {
+        auto events = make_shared<mapped_event_list>(event_list);
+        return boost::simulation::make_atomic_ptr<PMappedEventReader<Time, msg_type>, shared_ptr<mapped_event_list>, Time>(events, Time{0});
     }
-
-    //Plug the input events
     shared_ptr<istream> piss{ new ifstream{event_list} };
-    auto pf = boost::simulation::make_atomic_ptr<boost::simulation::pdevs::basic_models::input_stream<Time, msg_type, int, int>, shared_ptr<istream>, Time>(piss, Time{0});
-    counted_atomic_models++;
-
-    auto root = std::make_shared<boost::simulation::pdevs::coupled<Time, msg_type>>(boost::simulation::pdevs::coupled<Time, msg_type>({pf, cm}, {}, {{pf, cm}}, {cm}));
-    counted_coupled_models++;
-    return root;
+    return boost::simulation::make_atomic_ptr<boost::simulation::pdevs::basic_models::input_stream<Time, msg_type, int, int>, shared_ptr<istream>, Time>(piss, Time{0});
 }
 
-shared_ptr<boost::simulation::pdevs::coupled<Time, msg_type>> HI_coupling(int& counted_atomic_models, int& counted_coupled_models,
-                           int width, int depth, string event_list, int ext_cycles, int int_cycles, int time_advance)
+//CDBoost models have a single input and output port, so only kinds whose topology uses one port of each are supported
+shared_ptr<boost::simulation::pdevs::coupled<Time, msg_type>> devstone_coupling(int& counted_atomic_models, int& counted_coupled_models,
+                           const devstone_topology& topology, string event_list, int ext_cycles, int int_cycles, int time_advance, workload work,
+                           const shared_ptr<atomic_heap>& heap=nullptr)
 {
-    shared_ptr<boost::simulation::pdevs::coupled<Time, msg_type>> cm;
-    auto first_pdevstone = boost::simulation::make_atomic_ptr<PDEVStoneAtomic<Time, msg_type>, int, int, Time>(int_cycles, ext_cycles, Time(time_advance));
-    counted_atomic_models++;
-    cm.reset(new boost::simulation::pdevs::coupled<Time, msg_type>{{first_pdevstone}, {first_pdevstone}, {}, {first_pdevstone}});
-    counted_coupled_models++;
+    if (coupled_input_ports(topology.kind) > 1 || coupled_output_ports(topology.kind) > 1) {
+        throw runtime_error("CDBoost models have a single input and output port, HO and HOmod DEVStones can not be built");
+    }
+    using model_ptr = std::shared_ptr<boost::simulation::model<Time>>;
 
-    //connect higher level models
-
-    for (int i=1; i < depth; i++){
-        vector<std::shared_ptr<boost::simulation::model<Time>>> vpdt;
-        vector<std::shared_ptr<boost::simulation::model<Time>>> eoc_cm;
-        vector<std::shared_ptr<boost::simulation::model<Time>>> eic_cm;
-        vector<pair<std::shared_ptr<boost::simulation::model<Time>>, std::shared_ptr<boost::simulation::model<Time>>>> ic_cm;
-        vpdt.clear();
-        eoc_cm.clear();
-        eic_cm.clear();
-        ic_cm.clear();
-        eoc_cm.push_back(cm);
-        for (int j=0; j < width-1; j++){
-            std::shared_ptr<boost::simulation::model<Time>> current = std::shared_ptr<boost::simulation::model<Time>>(make_shared<PDEVStoneAtomic<Time, msg_type>>(int_cycles, ext_cycles, Time(time_advance)));
-            if (j > 0) ic_cm.push_back({vpdt.back(), current});
-            vpdt.push_back(current);
-            counted_atomic_models++;
-            eic_cm.push_back(current);
-        }
-        vpdt.push_back(cm);
-        eic_cm.push_back(cm);
+    vector<model_ptr> atomics;
+    atomics.reserve(topology.atomics.size());
+    for (size_t i=0; i < topology.atomics.size(); i++){
+        atomics.push_back(make_atomic_in<PDEVStoneAtomic<Time, msg_type>>(heap, int_cycles, ext_cycles, Time(time_advance), work));
+        counted_atomic_models++;
+    }
 
-        shared_ptr<boost::simulation::pdevs::coupled<Time, msg_type>> cm_int ( new boost::simulation::pdevs::coupled<Time, msg_type>{vpdt, eic_cm, ic_cm, eoc_cm});
+    vector<shared_ptr<boost::simulation::pdevs::coupled<Time, msg_type>>> coupleds;
+    coupleds.reserve(topology.coupleds.size());
+    auto model = [&atomics, &coupleds](topology_model m) -> model_ptr {
+        return (m.is_coupled ? model_ptr(coupleds[m.index]) : atomics[m.index]);
+    };
+
+    for (const topology_coupled& coupled : topology.coupleds){
+        vector<model_ptr> vpdt;
+        vector<model_ptr> eoc_cm;
+        vector<model_ptr> eic_cm;
+        vector<pair<model_ptr, model_ptr>> ic_cm;
+        vpdt.reserve(coupled.submodels);
+        for (uint32_t s=coupled.first_submodel; s < coupled.first_submodel + coupled.submodels; s++){
+            vpdt.push_back(model(topology.submodels[s]));
+        }
+        for (uint32_t c=coupled.first_coupling; c < coupled.first_coupling + coupled.couplings; c++){
+            const topology_coupling& coupling = topology.couplings[c];
+            switch (coupling.kind) {
+                case topology_eic: eic_cm.push_back(model(coupling.to)); break;
+                case topology_eoc: eoc_cm.push_back(model(coupling.from)); break;
+                case topology_ic: ic_cm.push_back({model(coupling.from), model(coupling.to)}); break;
+            }
+        }
+        coupleds.push_back(make_shared<boost::simulation::pdevs::coupled<Time, msg_type>>(vpdt, eic_cm, ic_cm, eoc_cm));
         counted_coupled_models++;
-        cm=cm_int;
     }
+    shared_ptr<boost::simulation::pdevs::coupled<Time, msg_type>> cm = coupleds.back();
 
     //Plug the input events
-    shared_ptr<istream> piss{ new ifstream{event_list} };
-    auto pf = boost::simulation::make_atomic_ptr<boost::simulation::pdevs::basic_models::input_stream<Time, msg_type, int, int>, shared_ptr<istream>, Time>(piss, Time{0});
-
+    auto pf = make_event_input(event_list);
     counted_atomic_models++;
 
     auto root = std::make_shared<boost::simulation::pdevs::coupled<Time, msg_type>>(boost::simulation::pdevs::coupled<Time, msg_type>({pf, cm}, {}, {{pf, cm}}, {cm}));
@@ -134,19 +113,24 @@ shared_ptr<boost::simulation::pdevs::coupled<Time, msg_type>> HI_coupling(int& c
 
 int main(int argc, char* argv[]){
     auto start = hclock::now();
+    select_allocator(argc, argv);
 
     // Declare the supported options.
     po::options_description desc("Allowed options");
     desc.add_options()
             ("help", "produce help message")
-            ("kind", po::value<string>()->required(), "set kind of devstone: LI, HI or HO")
+            ("kind", po::value<string>()->required(), "set kind of devstone: LI or HI, HO needs two ports which CDBoost models do not have")
             ("width", po::value<int>()->required(), "set width of the DEVStone: integer value")
             ("depth", po::value<int>()->required(), "set depth of the DEVStone: integer value")
-            ("int-cycles", po::value<int>()->required(), "set the Dhrystone cycles to expend in internal transtions: integer value")
-            ("ext-cycles", po::value<int>()->required(), "set the Dhrystone cycles to expend in external transtions: integer value")
             ("event-list", po::value<string>()->required(), "set the file to read the events. The format is 2 ints per line meaning time->msg")
             ("time-advance", po::value<int>()->default_value(1), "set the time expend in external transtions by the Dhrystone in miliseconds: integer value")
+            ("allocator", po::value<allocator_strategy>()->default_value(system_allocator), "set the allocator of every new and delete: system, pool or arena, which never frees")
+            ("huge-pages", po::bool_switch(), "back the memory of the pool and arena allocators with 2 MB transparent huge pages")
+            ("allocation-stats", po::bool_switch(), "count and print the allocations, bytes and peak live bytes of each phase")
+            ("heap-layout", po::value<heap_layout>()->default_value(system_heap), "set the placement of the atomics in memory: system, depth-first, breadth-first or scattered")
             ;
+    add_transition_cost_options(desc);
+    add_workload_options(desc);
 
     po::variables_map vm;
     try {
@@ -164,8 +148,8 @@ int main(int argc, char* argv[]){
         }
     }
     string kind = vm["kind"].as<string>();
-    if (kind.compare("LI") != 0  && kind.compare("HI") != 0 && kind.compare("HO") != 0) {
-        cout << "The kind needs to be LI, HI or HO and received value was: " << kind;
+    if (kind.compare("LI") != 0  && kind.compare("HI") != 0) {
+        cout << "The kind needs to be LI or HI and received value was: " << kind;
         cout << endl;
         cout << "for mode information run: " << argv[0] << " --help" << endl;
         return 1;
@@ -180,15 +164,37 @@ int main(int argc, char* argv[]){
         }
     }
 
+    if (vm["huge-pages"].as<bool>() && (vm["allocator"].as<allocator_strategy>() == system_allocator || !huge_pages_enabled())) {
+        cout << "Huge pages need the pool or arena allocator, and transparent huge pages enabled for madvise in the kernel" << endl;
+        cout << endl;
+        cout << "for mode information run: " << argv[0] << " --help" << endl;
+        return 1;
+    }
+
+    if (!transition_costs_are_valid(vm)) {
+        cout << "Each transition needs its cost either in cycles or in ns: --int-cycles or --int-ns, and --ext-cycles or --ext-ns" << endl;
+        cout << endl;
+        cout << "for mode information run: " << argv[0] << " --help" << endl;
+        return 1;
+    }
+
+    workload work = selected_workload(vm);
+    double ns_per_cycle = 0;
+    if (transition_costs_need_calibration(vm)) {
+        ns_per_cycle = workload_ns_per_cycle(work, vm["calibration-file"].as<string>());
+    }
+
     int width = vm["width"].as<int>();
     int depth = vm["depth"].as<int>();
-    int int_cycles = vm["int-cycles"].as<int>();
-    int ext_cycles = vm["ext-cycles"].as<int>();
+    int int_cycles = transition_cycles(vm, "int", ns_per_cycle);
+    int ext_cycles = transition_cycles(vm, "ext", ns_per_cycle);
     int time_advance = vm["time-advance"].as<int>();
     string event_list = vm["event-list"].as<string>();
+    heap_layout layout = vm["heap-layout"].as<heap_layout>();
     //finished processing input
 
     auto processed_parameters = hclock::now();
+    start_allocation_phase(construction_phase);
 
     //create models for LI kind
     int models_quantity = (width - 1) * (depth - 1) + 1;
@@ -196,25 +202,29 @@ int main(int argc, char* argv[]){
     int counted_coupled_models=0;
 
 
-    shared_ptr<boost::simulation::pdevs::coupled<Time, msg_type>> root;
-    if (kind.compare("LI") == 0){
-        root = LI_coupling(counted_atomic_models, counted_coupled_models, width, depth, event_list, ext_cycles, int_cycles, time_advance);
-    } else if (kind.compare("HI") == 0){
-        root = HI_coupling(counted_atomic_models, counted_coupled_models, width, depth, event_list, ext_cycles, int_cycles, time_advance);
-    } else {
-        abort();
+    devstone_topology topology = make_devstone_topology(kind.compare("LI") == 0 ? LI : HI, width, depth);
+
+    auto topology_built = hclock::now();
+
+    shared_ptr<atomic_heap> heap;
+    if (layout != system_heap) {
+        heap = make_shared<atomic_heap>(layout, topology);
     }
+    shared_ptr<boost::simulation::pdevs::coupled<Time, msg_type>> root = devstone_coupling(counted_atomic_models, counted_coupled_models, topology, event_list, ext_cycles, int_cycles, time_advance, work, heap);
 
     auto model_built = hclock::now();
+    start_allocation_phase(initialization_phase);
 
     //run the model
     boost::simulation::pdevs::runner<Time, msg_type> r(root, Time{0});
 
     auto model_init = hclock::now();
+    start_allocation_phase(simulation_phase);
 
     r.runUntilPassivate();
 
     auto finished_simulation = hclock::now();
+    start_allocation_phase(reporting_phase);
 
     cout << "Simulation with params: ";
 
@@ -225,6 +235,14 @@ int main(int argc, char* argv[]){
             std::cout << *v;
         else if (auto v = boost::any_cast<std::string>(&value))
             std::cout << *v;
+        else if (auto v = boost::any_cast<workload_kernel>(&value))
+            std::cout << *v;
+        else if (auto v = boost::any_cast<heap_layout>(&value))
+            std::cout << *v;
+        else if (auto v = boost::any_cast<allocator_strategy>(&value))
+            std::cout << *v;
+        else if (auto v = boost::any_cast<bool>(&value))
+            std::cout << (*v ? "yes" : "no");
         else
             std::cout << "error";
         cout << " ";
@@ -232,12 +250,24 @@ int main(int argc, char* argv[]){
 
 
     cout << endl;
+    cout << "kernel: " << work.kernel << " buffer: " << work.buffer_bytes << " bytes" << endl;
+    if (ns_per_cycle > 0) {
+        cout << "kernel calibration: " << ns_per_cycle << "ns per cycle, internal cycles: " << int_cycles << " external cycles: " << ext_cycles << endl;
+    }
     cout << "theory atomic models created: " << models_quantity << std::endl;
     cout << "real atomic models created: " << counted_atomic_models << " coupled models created: "<<  counted_coupled_models << std::endl;
     cout << "real total models created: " << counted_atomic_models + counted_coupled_models << std::endl;
     cout << "time processing arguments: " << chrono::duration_cast<chrono::duration<double, ratio<1>>>( processed_parameters - start).count() << endl;
     cout << "time constructing the models: " << chrono::duration_cast<chrono::duration<double, ratio<1>>>( model_built - processed_parameters).count() << endl;
+    cout << "time building the topology: " << chrono::duration_cast<chrono::duration<double, ratio<1>>>( topology_built - processed_parameters).count() << endl;
+    cout << "time translating the topology: " << chrono::duration_cast<chrono::duration<double, ratio<1>>>( model_built - topology_built).count() << endl;
     cout << "time initializing the models: " << chrono::duration_cast<chrono::duration<double, ratio<1>>>( model_init - model_built).count() << endl;
+    cout << "heap layout: " << layout;
+    if (heap) {
+        cout << " arena: " << heap->arena_bytes() << " bytes";
+    }
+    cout << endl;
     cout << "time running simulation: " << chrono::duration_cast<chrono::duration<double, ratio<1>>>( finished_simulation - model_init).count() << endl;
     cout << "total time: " << chrono::duration_cast<chrono::duration<double, ratio<1>>>( finished_simulation - start).count() << endl;
+    print_allocation_stats(cout);
 }
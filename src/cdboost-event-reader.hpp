@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2013-2014, Carleton University, Universite de Nice-Sophia Antipolis
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef P_EVENT_READER_H
+#define P_EVENT_READER_H
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <boost/simulation/pdevs/atomic.hpp>
+#include "event-list-binary.hpp"
+
+namespace cdpp {
+/**
+ * @brief Event reader for binary event lists.
+ *
+ * Sends the values of the records in a mapped binary event list (see event-list-binary.hpp)
+ * at their times, all the records sharing a time are sent in the same output.
+*/
+template<class TIME, class MSG>
+class PMappedEventReader : public boost::simulation::pdevs::atomic<TIME, MSG>
+{
+    std::shared_ptr<mapped_event_list> _events;
+    const event_record* _batch_begin;
+    const event_record* _batch_end;
+    TIME _last;
+public:
+    /**
+     * @brief PMappedEventReader constructor.
+     *
+     * @param events the mapped event list, it is shared so the mapping outlives the model.
+     * @param initial_time the time the simulation starts.
+     */
+    explicit PMappedEventReader(std::shared_ptr<mapped_event_list> events, TIME initial_time)
+        : _events(events), _batch_begin(events->begin()), _batch_end(events->begin()), _last(initial_time)
+    {
+        find_batch_end();
+    }
+    /**
+     * @brief internal function, moves to the records of the next time.
+     */
+    void internal() noexcept {
+        _last = TIME(_batch_begin->time);
+        _batch_begin = _batch_end;
+        find_batch_end();
+        if (_batch_begin != _events->end() && TIME(_batch_begin->time) < _last) {
+            //transitions cannot throw in CDBoost
+            std::cerr << "next is before than now" << std::endl;
+            std::abort();
+        }
+    }
+    /**
+     * @brief advance function.
+     * @return Time until the records of the next time are sent.
+     */
+    TIME advance() const noexcept {
+        if (_batch_begin == _events->end()) return boost::simulation::pdevs::atomic<TIME, MSG>::infinity;
+        return TIME(_batch_begin->time) - _last;
+    }
+    /**
+     * @brief out function.
+     * @return The values of all records sharing the next time.
+     */
+    std::vector<MSG> out() const noexcept {
+        std::vector<MSG> values;
+        values.reserve(_batch_end - _batch_begin);
+        for (const event_record* it = _batch_begin; it != _batch_end; ++it) {
+            values.push_back(it->value);
+        }
+        return values;
+    }
+    /**
+     * @brief external function domain is empty.
+     * @param msg external input message.
+     * @param t time the external input is received.
+     */
+    void external(const std::vector<MSG>& msg, const TIME& t) noexcept {
+        assert(false && "Non external input is expected in this model");
+    }
+    /**
+     * @brief confluence function domain is empty.
+     * @param mb is a bag of messages coming from outside
+     * @param t is the time the message is received
+     */
+    void confluence(const std::vector<MSG>& mb, const TIME& t) noexcept {
+        assert(false && "Non external input is expected in this model");
+    }
+
+private:
+    void find_batch_end() {
+        _batch_end = _batch_begin;
+        while (_batch_end != _events->end() && _batch_end->time == _batch_begin->time) {
+            ++_batch_end;
+        }
+    }
+};
+
+}
+
+#endif // P_EVENT_READER_H
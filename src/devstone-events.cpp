@@ -0,0 +1,163 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+#include "event-list-binary.hpp"
+#include "event-text-parser.hpp"
+#include "event-list-sort.hpp"
+
+namespace po=boost::program_options;
+using hclock=std::chrono::high_resolution_clock;
+
+// Tool for preparing event lists for the DEVStone event readers.
+// convert: translates a text event list ("time value" per line) into a binary event list, or back.
+// sort: sorts a text or binary event list of any size by time, using a bounded amount of memory.
+
+// Returns the number of records written
+std::uint64_t convert_text_to_binary(const std::string& input, const std::string& output) {
+    event_text_parser parser(input);
+    std::ofstream os(output, std::ios_base::binary);
+    if (!os.good()) throw std::runtime_error("failed to open output file: " + output);
+
+    write_event_list_header(os, 0); //the amount of records is known at the end
+    std::uint64_t records = 0;
+    for (; parser.has_next(); parser.pop()) {
+        write_event_record(os, parser.next_time(), parser.next_value());
+        records++;
+    }
+    os.seekp(0);
+    write_event_list_header(os, records);
+    if (!os.good()) throw std::runtime_error("failed writing output file: " + output);
+    return records;
+}
+
+// Returns the number of records written
+std::uint64_t convert_binary_to_text(const std::string& input, const std::string& output) {
+    mapped_event_list events(input);
+    std::ofstream os(output);
+    if (!os.good()) throw std::runtime_error("failed to open output file: " + output);
+    os << std::setprecision(std::numeric_limits<double>::max_digits10);
+    for (const event_record& record : events) {
+        os << record.time << ' ' << record.value << '\n';
+    }
+    if (!os.good()) throw std::runtime_error("failed writing output file: " + output);
+    return events.size();
+}
+
+int main(int argc, char* argv[]){
+    auto start = hclock::now();
+
+    // Declare the supported options.
+    po::options_description desc("Allowed options");
+    desc.add_options()
+            ("help", "produce help message")
+            ("command", po::value<std::string>()->required(), "set the command to run: convert or sort")
+            ("input", po::value<std::string>()->required(), "set the event list to read")
+            ("output", po::value<std::string>()->required(), "set the event list to write")
+            ("to", po::value<std::string>()->default_value("binary"), "set the format of the output: binary or text")
+            ("memory-mb", po::value<int>()->default_value(256), "set the memory used by sort in megabytes: integer value")
+            ("dedup", "drop repeated events with the same time and value when sorting, events at the same time are then ordered by value unless coalescing")
+            ("coalesce", "keep only the first event of each time when sorting")
+            ("temp-prefix", po::value<std::string>(), "set the prefix of the temporary files of sort, the output name by default")
+            ;
+    po::positional_options_description positional;
+    positional.add("command", 1);
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+        po::notify(vm);
+    } catch ( boost::program_options::required_option be ){
+        if (vm.count("help")) {
+            std::cout << "usage: " << argv[0] << " <command> [options]" << std::endl;
+            std::cout << desc << "\n";
+            return 0;
+        } else {
+            std::cout << be.what() << std::endl;
+            std::cout << std::endl;
+            std::cout << "for mode information run: " << argv[0] << " --help" << std::endl;
+            return 1;
+        }
+    }
+
+    std::string command = vm["command"].as<std::string>();
+    std::string input = vm["input"].as<std::string>();
+    std::string output = vm["output"].as<std::string>();
+    std::string to = vm["to"].as<std::string>();
+    if ((command != "convert" && command != "sort") || (to != "binary" && to != "text")) {
+        std::cout << "The command needs to be convert or sort, with --to binary or text" << std::endl;
+        std::cout << std::endl;
+        std::cout << "for mode information run: " << argv[0] << " --help" << std::endl;
+        return 1;
+    }
+
+    auto processed_parameters = hclock::now();
+
+    std::uint64_t records;
+    event_sort_stats sort_stats;
+    try {
+        if (command == "sort") {
+            event_sort_options options;
+            options.memory_bytes = static_cast<std::size_t>(std::max(vm["memory-mb"].as<int>(), 1)) << 20;
+            options.dedup = vm.count("dedup") > 0;
+            options.coalesce = vm.count("coalesce") > 0;
+            options.binary_output = (to == "binary");
+            options.temp_prefix = (vm.count("temp-prefix") ? vm["temp-prefix"].as<std::string>() : output);
+            sort_stats = event_list_sorter(options).sort(input, output);
+            records = sort_stats.records_written;
+        } else {
+            records = (to == "binary" ? convert_text_to_binary(input, output) : convert_binary_to_text(input, output));
+        }
+    } catch (const std::runtime_error& e) {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    auto finished = hclock::now();
+    double elapsed = std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>(finished - processed_parameters).count();
+    std::ifstream in_file(input, std::ios_base::binary | std::ios_base::ate);
+    double megabytes = static_cast<double>(in_file.tellg()) / (1024 * 1024);
+
+    if (command == "sort") {
+        std::cout << "records read: " << sort_stats.records_read << std::endl;
+        std::cout << "records written: " << records << std::endl;
+        std::cout << "sorted runs: " << sort_stats.runs << " merge passes: " << sort_stats.merge_passes << std::endl;
+        std::cout << "time sorting: " << elapsed << std::endl;
+    } else {
+        std::cout << "records converted: " << records << std::endl;
+        std::cout << "time converting: " << elapsed << std::endl;
+    }
+    std::cout << "input throughput (MB/s): " << (elapsed > 0 ? megabytes / elapsed : 0) << std::endl;
+    std::cout << "total time: " << std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>(finished - start).count() << std::endl;
+    return 0;
+}
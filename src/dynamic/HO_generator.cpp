@@ -28,6 +28,10 @@
 
 #include "../cadmium-devstone-atomic.hpp"
 #include "../cadmium-event-reader.hpp"
+#include "event_inputs.hpp"
+#include "model_ids.hpp"
+#include "parallel_build.hpp"
+#include "topology_adapter.hpp"
 
 #include <cadmium/modeling/coupled_model.hpp>
 #include <cadmium/modeling/ports.hpp>
@@ -47,123 +51,128 @@ struct coupledHO_in_port2 : public cadmium::in_port<int>{};
 struct coupledHO_out_port1 : public cadmium::out_port<int>{};
 struct coupledHO_out_port2 : public cadmium::out_port<int>{};
 
+// Ports of the coupled models for the topology adapter
+struct HO_topology_ports {
+    using in1 = coupledHO_in_port1;
+    using in2 = coupledHO_in_port2;
+    using out1 = coupledHO_out_port1;
+    using out2 = coupledHO_out_port2;
+};
+
 std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> create_HO_model(
-         unsigned int width,  unsigned int depth, int ext_cycles, int int_cycles, TIME time_advance) {
+         unsigned int width,  unsigned int depth, int ext_cycles, int int_cycles, TIME time_advance, workload work=workload(), const event_inputs& inputs=event_inputs(), unsigned int build_threads=1) {
     // Creates the HO model with the passed parameters
     // Returns a shared_ptr to the TOP model
 
-    auto make_atomic_devstone = [&ext_cycles, &int_cycles, &time_advance](std::string model_id) -> std::shared_ptr<cadmium::dynamic::modeling::model> {
-        return cadmium::dynamic::translate::make_dynamic_atomic_model<devstone_atomic, TIME>(model_id, ext_cycles, int_cycles, time_advance);
+    auto make_atomic_devstone = [&ext_cycles, &int_cycles, &time_advance, &work](const std::string& model_id) -> std::shared_ptr<cadmium::dynamic::modeling::model> {
+        return cadmium::dynamic::translate::make_dynamic_atomic_model<devstone_atomic, TIME>(model_id, ext_cycles, int_cycles, time_advance, work);
     };
     //Level 0 has always a single model
-    std::shared_ptr<cadmium::dynamic::modeling::model> devstone_atomic_L0_0 = make_atomic_devstone("devstone_atomic_L0_0");
-
-    std::unordered_map<int, cadmium::dynamic::modeling::Models> atomics_by_level;
-    std::unordered_map<int, std::shared_ptr<cadmium::dynamic::modeling::model>> coupleds_by_level;
+    const std::string devstone_atomic_L0_0_id = "devstone_atomic_L0_0";
+    std::shared_ptr<cadmium::dynamic::modeling::model> devstone_atomic_L0_0 = make_atomic_devstone(devstone_atomic_L0_0_id);
 
     cadmium::dynamic::modeling::Ports coupled_in_ports = {typeid(coupledHO_in_port1), typeid(coupledHO_in_port2)};
     cadmium::dynamic::modeling::Ports coupled_out_ports = {typeid(coupledHO_out_port1), typeid(coupledHO_out_port2)};
+    unsigned int threads = build_threads_for(build_threads);
+
+    //atomics of every level but the last one, which does not have atomics
+    //ids are built once and used by reference for the models and their couplings
+    std::size_t atomics_per_level = width - 1;
+    std::vector<cadmium::dynamic::modeling::Models> atomics_by_level(depth);
+    std::vector<std::vector<std::string>> atomic_ids_by_level(depth);
+    for (int level=1; level < depth; level++) {
+        atomics_by_level[level].resize(atomics_per_level);
+        atomic_ids_by_level[level].resize(atomics_per_level);
+    }
+    parallel_for(0, std::size_t(depth - 1) * atomics_per_level, threads, [&](std::size_t i) {
+        unsigned int level = 1 + i / atomics_per_level;
+        unsigned int idx_atomic = i % atomics_per_level;
+        std::string& atomic_id = atomic_ids_by_level[level][idx_atomic];
+        atomic_id = devstone_ids::atomic(level, idx_atomic);
+        atomics_by_level[level][idx_atomic] = make_atomic_devstone(atomic_id);
+    });
+
+    //couplings of every level, the atomics of a level are moved to the coupled of the next one
+    std::vector<level_couplings> couplings_by_level(depth + 1);
+    couplings_by_level[1].submodels = {devstone_atomic_L0_0};
+    couplings_by_level[1].eics = {
+        cadmium::dynamic::translate::make_EIC<coupledHO_in_port1, devstone_atomic_defs::in>(devstone_atomic_L0_0_id)
+    };
+    couplings_by_level[1].eocs = {
+        cadmium::dynamic::translate::make_EOC<devstone_atomic_defs::out,coupledHO_out_port1>(devstone_atomic_L0_0_id)
+    };
+    parallel_for(2, std::size_t(depth) + 1, threads, [&](std::size_t level) {
+        level_couplings& couplings = couplings_by_level[level];
+        cadmium::dynamic::modeling::Models& atomics_prev_level = atomics_by_level[level - 1];
+        const std::vector<std::string>& atomic_ids = atomic_ids_by_level[level - 1];
+        std::string coupled_prev_level_id = devstone_ids::coupled(level - 1);
+        couplings.submodels.reserve(1 + atomics_prev_level.size());
+        couplings.eics.reserve(2 + atomics_prev_level.size());
+        couplings.eocs.reserve(1 + atomics_prev_level.size());
+        couplings.ics.reserve(atomics_prev_level.empty() ? 0 : atomics_prev_level.size() - 1);
+
+        couplings.submodels.emplace_back(); //the coupled of the previous level, set when chaining the levels
+        couplings.eics.push_back(
+            cadmium::dynamic::translate::make_EIC<coupledHO_in_port1, coupledHO_in_port1>(coupled_prev_level_id)
+        );
+        couplings.eics.push_back(
+            cadmium::dynamic::translate::make_EIC<coupledHO_in_port1, coupledHO_in_port2>(coupled_prev_level_id)
+        );
+        couplings.eocs.push_back(
+            cadmium::dynamic::translate::make_EOC<coupledHO_out_port1, coupledHO_out_port1>(coupled_prev_level_id)
+        );
 
-    for (int level=1; level <= depth; level++) {
-
-        //atomics
-        std::vector<std::shared_ptr<cadmium::dynamic::modeling::model>> atomics_current_level;
-        if (level < depth) {
-            //Last level does not have atomics
-            atomics_current_level.reserve(width-1);
-            for(int idx_atomic=0; idx_atomic < width-1; idx_atomic++) {
-                std::string atomic_name = "devstone_atomic_L" + std::to_string(level) + "_" + std::to_string(idx_atomic);
-                atomics_current_level.push_back(make_atomic_devstone(atomic_name));
-            }
-        }
-        atomics_by_level[level] = atomics_current_level;
-
-        //coupled
-        cadmium::dynamic::modeling::Models Lcoupled_submodels;
-        cadmium::dynamic::modeling::EICs Lcoupled_eics;
-        cadmium::dynamic::modeling::EOCs Lcoupled_eocs;
-        cadmium::dynamic::modeling::ICs Lcoupled_ics = {};
-
-        if (level == 1) {
-            Lcoupled_submodels= {devstone_atomic_L0_0};
-            Lcoupled_eics = {
-                cadmium::dynamic::translate::make_EIC<coupledHO_in_port1, devstone_atomic_defs::in>("devstone_atomic_L0_0")
-            };
-            Lcoupled_eocs = {
-              cadmium::dynamic::translate::make_EOC<devstone_atomic_defs::out,coupledHO_out_port1>("devstone_atomic_L0_0")
-            };
-        } else {
-            std::shared_ptr<cadmium::dynamic::modeling::model> coupled_prev_level = coupleds_by_level[level - 1];
-
-            Lcoupled_submodels = { coupled_prev_level };
-
-            Lcoupled_eics = {
-                cadmium::dynamic::translate::make_EIC<coupledHO_in_port1, coupledHO_in_port1>(
-                    coupled_prev_level.get()->get_id()
-                ),
-                cadmium::dynamic::translate::make_EIC<coupledHO_in_port1, coupledHO_in_port2>(
-                    coupled_prev_level.get()->get_id()
-                )
-            };
-
-            Lcoupled_eocs = {
-                cadmium::dynamic::translate::make_EOC<coupledHO_out_port1, coupledHO_out_port1>(
-                    coupled_prev_level.get()->get_id()
-                )
-            };
-            for (int i=0; i < atomics_by_level[level - 1].size(); i++) {
-                auto atomic = atomics_by_level[level - 1][i];
-                Lcoupled_submodels.push_back(atomic);
-                Lcoupled_eics.push_back(
-                    cadmium::dynamic::translate::make_EIC<coupledHO_in_port2, devstone_atomic_defs::in>(atomic.get()->get_id())
-                );
-                Lcoupled_eocs.push_back(
-                    cadmium::dynamic::translate::make_EOC<devstone_atomic_defs::out, coupledHO_out_port2>(atomic.get()->get_id())
+        for (int i=0; i < atomics_prev_level.size(); i++) {
+            couplings.eics.push_back(
+                cadmium::dynamic::translate::make_EIC<coupledHO_in_port2, devstone_atomic_defs::in>(atomic_ids[i])
+            );
+            couplings.eocs.push_back(
+                cadmium::dynamic::translate::make_EOC<devstone_atomic_defs::out, coupledHO_out_port2>(atomic_ids[i])
+            );
+            if(i < atomics_prev_level.size()- 1 ) { // skip last iteration
+                couplings.ics.push_back(
+                    cadmium::dynamic::translate::make_IC<devstone_atomic_defs::out, devstone_atomic_defs::in>(atomic_ids[i], atomic_ids[i+1])
                 );
-                if(i < atomics_by_level[level - 1].size()- 1 ) { // skip last iteration
-                    auto next_atomic = atomics_by_level[level - 1][i+1];
-                    Lcoupled_ics.push_back(
-                        cadmium::dynamic::translate::make_IC<devstone_atomic_defs::out, devstone_atomic_defs::in>(atomic.get()->get_id(), next_atomic.get()->get_id())
-                    );
-                }
             }
+            couplings.submodels.push_back(std::move(atomics_prev_level[i]));
+        }
+        cadmium::dynamic::modeling::Models().swap(atomics_prev_level);
+        std::vector<std::string>().swap(atomic_ids_by_level[level - 1]);
+    }, 1);
+
+    //chaining the levels, each coupled is a submodel of the next one
+    std::shared_ptr<cadmium::dynamic::modeling::model> last_level_coupled;
+    for (int level=1; level <= depth; level++) {
+        level_couplings& couplings = couplings_by_level[level];
+        if (level > 1) {
+            couplings.submodels.front() = std::move(last_level_coupled);
         }
-        std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> L_coupled = std::make_shared<cadmium::dynamic::modeling::coupled<TIME>>(
-             "L" + std::to_string(level) + "_coupled",
-             Lcoupled_submodels,
+        last_level_coupled = std::make_shared<cadmium::dynamic::modeling::coupled<TIME>>(
+             devstone_ids::coupled(level),
+             std::move(couplings.submodels),
              coupled_in_ports,
              coupled_out_ports,
-             Lcoupled_eics,
-             Lcoupled_eocs,
-             Lcoupled_ics
+             std::move(couplings.eics),
+             std::move(couplings.eocs),
+             std::move(couplings.ics)
         );
-        coupleds_by_level[level] = L_coupled;
     }
 
-    //Create instance of devstone_event_reader
-    std::shared_ptr<cadmium::dynamic::modeling::model> devstone_event_reader1 = cadmium::dynamic::translate::make_dynamic_atomic_model<devstone_event_reader, TIME>("devstone_event_reader1");
-
-    std::shared_ptr<cadmium::dynamic::modeling::model> last_level_coupled = coupleds_by_level[depth];
+    //TOP model conecting the event readers to the input
+    return create_TOP_model<TIME, coupledHO_in_port1, coupledHO_in_port2>(inputs, last_level_coupled);
+}
 
-    //TOP model conecting a generator of events to the input
-    cadmium::dynamic::modeling::Ports TOP_coupled_in_ports = {};
-    cadmium::dynamic::modeling::Ports TOP_coupled_out_ports = {};
-    cadmium::dynamic::modeling::Models TOP_submodels = {devstone_event_reader1, last_level_coupled};
-    cadmium::dynamic::modeling::EICs TOP_eics = {};
-    cadmium::dynamic::modeling::EOCs TOP_eocs = {};
-    cadmium::dynamic::modeling::ICs TOP_ics = {
-        cadmium::dynamic::translate::make_IC<devstone_event_reader_defs::out,coupledHO_in_port1>("devstone_event_reader1",last_level_coupled.get()->get_id()),
-        cadmium::dynamic::translate::make_IC<devstone_event_reader_defs::out,coupledHO_in_port2>("devstone_event_reader1",last_level_coupled.get()->get_id())
+std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> create_HO_model_from_topology(
+         const topology_view& topology, int ext_cycles, int int_cycles, TIME time_advance, workload work=workload(), const event_inputs& inputs=event_inputs(),
+         const std::shared_ptr<atomic_heap>& heap=nullptr, unsigned int build_threads=1) {
+    // Creates the HO model translating a topology built by make_devstone_topology, placing the atomics in the heap if given
+    // The atomics of a heap are allocated in the order of the topology, so they are built on a single thread
+    // Returns a shared_ptr to the TOP model
+    auto make_atomic_devstone = [&ext_cycles, &int_cycles, &time_advance, &work, &heap](const std::string& model_id) -> std::shared_ptr<cadmium::dynamic::modeling::model> {
+        return make_dynamic_atomic_model_in<devstone_atomic, TIME>(heap, model_id, ext_cycles, int_cycles, time_advance, work);
     };
-    std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> TOP_coupled = std::make_shared<cadmium::dynamic::modeling::coupled<TIME>>(
-     "TOP_coupled",
-     TOP_submodels,
-     TOP_coupled_in_ports,
-     TOP_coupled_out_ports,
-     TOP_eics,
-     TOP_eocs,
-     TOP_ics
-    );
-
-    return TOP_coupled;
+    std::shared_ptr<cadmium::dynamic::modeling::model> last_level_coupled = create_coupled_from_topology<TIME, HO_topology_ports>(topology, make_atomic_devstone, heap ? 1 : build_threads);
+
+    //TOP model conecting the event readers to the input
+    return create_TOP_model<TIME, coupledHO_in_port1, coupledHO_in_port2>(inputs, last_level_coupled);
 }
@@ -28,6 +28,10 @@
 
 #include "../cadmium-devstone-atomic.hpp"
 #include "../cadmium-event-reader.hpp"
+#include "event_inputs.hpp"
+#include "model_ids.hpp"
+#include "parallel_build.hpp"
+#include "topology_adapter.hpp"
 
 #include <cadmium/modeling/coupled_model.hpp>
 #include <cadmium/modeling/ports.hpp>
@@ -47,135 +51,146 @@ struct coupledHOmod_in_port2 : public cadmium::in_port<int>{};
 struct coupledHOmod_out_port : public cadmium::out_port<int>{};
 
 using ModelMatrix = std::vector<std::vector<std::shared_ptr<cadmium::dynamic::modeling::model>>>;
+using IdMatrix = std::vector<std::vector<std::string>>;
+
+// Ports of the coupled models for the topology adapter, HOmod has a single output port
+struct HOmod_topology_ports {
+    using in1 = coupledHOmod_in_port1;
+    using in2 = coupledHOmod_in_port2;
+    using out1 = coupledHOmod_out_port;
+    using out2 = coupledHOmod_out_port;
+};
 
 std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> create_HOmod_model(
-         unsigned int width,  unsigned int depth, int ext_cycles, int int_cycles, TIME time_advance) {
+         unsigned int width,  unsigned int depth, int ext_cycles, int int_cycles, TIME time_advance, workload work=workload(), const event_inputs& inputs=event_inputs(), unsigned int build_threads=1) {
     // Creates the HOmod model with the passed parameters
     // Returns a shared_ptr to the TOP model
 
-    auto make_atomic_devstone = [&ext_cycles, &int_cycles, &time_advance](std::string model_id) -> std::shared_ptr<cadmium::dynamic::modeling::model> {
-        return cadmium::dynamic::translate::make_dynamic_atomic_model<devstone_atomic, TIME>(model_id, ext_cycles, int_cycles, time_advance);
+    auto make_atomic_devstone = [&ext_cycles, &int_cycles, &time_advance, &work](const std::string& model_id) -> std::shared_ptr<cadmium::dynamic::modeling::model> {
+        return cadmium::dynamic::translate::make_dynamic_atomic_model<devstone_atomic, TIME>(model_id, ext_cycles, int_cycles, time_advance, work);
     };
     //Level 0 has always a single model
-    std::shared_ptr<cadmium::dynamic::modeling::model> devstone_atomic_L0_0 = make_atomic_devstone("devstone_atomic_L0_0");
-    std::unordered_map<int, ModelMatrix> atomics_by_level;
-    std::unordered_map<int, std::shared_ptr<cadmium::dynamic::modeling::model>> coupleds_by_level;
+    const std::string devstone_atomic_L0_0_id = "devstone_atomic_L0_0";
+    std::shared_ptr<cadmium::dynamic::modeling::model> devstone_atomic_L0_0 = make_atomic_devstone(devstone_atomic_L0_0_id);
 
     cadmium::dynamic::modeling::Ports coupled_in_ports = {typeid(coupledHOmod_in_port1), typeid(coupledHOmod_in_port2)};
     cadmium::dynamic::modeling::Ports coupled_out_ports = {typeid(coupledHOmod_out_port)};
+    unsigned int threads = build_threads_for(build_threads);
+
+    //column c of a level has c + 2 atomics
+    std::size_t columns_per_level = width - 1;
+    std::size_t atomics_per_level = (width > 1 ? std::size_t(width - 1) * (width + 2) / 2 : 0);
+
+    //atomics of every level but the last one, which does not have atomics, built by columns
+    //ids are built once and used by reference for the models and their couplings
+    std::vector<ModelMatrix> atomics_by_level(depth);
+    std::vector<IdMatrix> atomic_ids_by_level(depth);
+    for (int level=1; level < depth; level++) {
+        atomics_by_level[level].resize(columns_per_level);
+        atomic_ids_by_level[level].resize(columns_per_level);
+    }
+    parallel_for(0, std::size_t(depth - 1) * columns_per_level, threads, [&](std::size_t i) {
+        unsigned int level = 1 + i / columns_per_level;
+        unsigned int idx_column = i % columns_per_level;
+        cadmium::dynamic::modeling::Models& models_col = atomics_by_level[level][idx_column];
+        std::vector<std::string>& ids_col = atomic_ids_by_level[level][idx_column];
+        ids_col = devstone_ids::column_atomics(level, idx_column, idx_column + 2);
+        models_col.reserve(idx_column + 2);
+        for(const std::string& atomic_id : ids_col) {
+            models_col.push_back(make_atomic_devstone(atomic_id));
+        }
+    }, 1);
 
-    for (int level=1; level <= depth; level++) {
+    //couplings of every level, the atomics of a level are moved to the coupled of the next one
+    std::vector<level_couplings> couplings_by_level(depth + 1);
+    couplings_by_level[1].submodels = {devstone_atomic_L0_0};
+    couplings_by_level[1].eics = {
+        cadmium::dynamic::translate::make_EIC<coupledHOmod_in_port1, devstone_atomic_defs::in>(devstone_atomic_L0_0_id)
+    };
+    couplings_by_level[1].eocs = {
+        cadmium::dynamic::translate::make_EOC<devstone_atomic_defs::out,coupledHOmod_out_port>(devstone_atomic_L0_0_id)
+    };
+    parallel_for(2, std::size_t(depth) + 1, threads, [&](std::size_t level) {
+        level_couplings& couplings = couplings_by_level[level];
+        ModelMatrix& atomics_prev_level = atomics_by_level[level - 1];
+        const IdMatrix& ids_prev_level = atomic_ids_by_level[level - 1];
+        std::string coupled_prev_level_id = devstone_ids::coupled(level - 1);
+        couplings.submodels.reserve(1 + atomics_per_level);
+        couplings.eics.reserve(1 + 2 * atomics_prev_level.size());
+        couplings.eocs.reserve(1);
+        couplings.ics.reserve(atomics_per_level);
+
+        couplings.submodels.emplace_back(); //the coupled of the previous level, set when chaining the levels
+
+        couplings.eics.push_back(
+            cadmium::dynamic::translate::make_EIC<coupledHOmod_in_port1, coupledHOmod_in_port1>(coupled_prev_level_id)
+        );
+
+        couplings.eocs.push_back(
+            cadmium::dynamic::translate::make_EOC<coupledHOmod_out_port, coupledHOmod_out_port>(coupled_prev_level_id)
+        );
+
+        for(int idx_column=0; idx_column < width-1; idx_column++) {
+            cadmium::dynamic::modeling::Models& models_col = atomics_prev_level[idx_column];
+            const std::vector<std::string>& ids_col = ids_prev_level[idx_column];
+            for(int idx_row=0; idx_row < idx_column + 2; idx_row++) {
+                const std::string& atomic_id = ids_col[idx_row];
 
-        //atomics
-        ModelMatrix atomics_current_level;
-        if (level < depth) {
-            //Last level does not have atomics
-            atomics_current_level.reserve(width-1);
-            for(int idx_column=0; idx_column < width-1; idx_column++) {
-                cadmium::dynamic::modeling::Models models_col;
-                models_col.reserve(idx_column+2);
-                for(int idx_row=0; idx_row < idx_column + 2; idx_row++) {
-                    std::string atomic_name = "devstone_atomic_L" + std::to_string(level) + "_" + std::to_string(idx_column) + "," + std::to_string(idx_row);
-                    models_col.push_back(make_atomic_devstone(atomic_name));
+                if(idx_row == 0 || idx_row == idx_column + 1) { //only first and last row
+                    couplings.eics.push_back(
+                            cadmium::dynamic::translate::make_EIC<coupledHOmod_in_port2, devstone_atomic_defs::in>(atomic_id)
+                    );
                 }
-                atomics_current_level.push_back(models_col);
-            }
-        }
-        atomics_by_level[level] = atomics_current_level;
-
-        //coupled
-        cadmium::dynamic::modeling::Models Lcoupled_submodels;
-        cadmium::dynamic::modeling::EICs Lcoupled_eics;
-        cadmium::dynamic::modeling::EOCs Lcoupled_eocs;
-        cadmium::dynamic::modeling::ICs Lcoupled_ics = {};
-
-        if (level == 1) {
-            Lcoupled_submodels= {devstone_atomic_L0_0};
-            Lcoupled_eics = {
-                cadmium::dynamic::translate::make_EIC<coupledHOmod_in_port1, devstone_atomic_defs::in>("devstone_atomic_L0_0")
-            };
-            Lcoupled_eocs = {
-              cadmium::dynamic::translate::make_EOC<devstone_atomic_defs::out,coupledHOmod_out_port>("devstone_atomic_L0_0")
-            };
-        } else {
-            std::shared_ptr<cadmium::dynamic::modeling::model> coupled_prev_level = coupleds_by_level[level - 1];
-
-            Lcoupled_submodels = { coupled_prev_level };
-
-            Lcoupled_eics = {
-                cadmium::dynamic::translate::make_EIC<coupledHOmod_in_port1, coupledHOmod_in_port1>(
-                    coupled_prev_level.get()->get_id()
-                )
-            };
-
-            Lcoupled_eocs = {
-                cadmium::dynamic::translate::make_EOC<coupledHOmod_out_port, coupledHOmod_out_port>(
-                    coupled_prev_level.get()->get_id()
-                )
-            };
-
-            ModelMatrix atomics_prev_level = atomics_by_level[level-1];
-            for(int idx_column=0; idx_column < width-1; idx_column++) {
-                cadmium::dynamic::modeling::Models models_col;
-                for(int idx_row=0; idx_row < idx_column + 2; idx_row++) {
-                    auto atomic = atomics_prev_level[idx_column][idx_row];
-                    Lcoupled_submodels.push_back(atomic);
-
-                    if(idx_row == 0 || idx_row == idx_column + 1) { //only first and last row
-                        Lcoupled_eics.push_back(
-                                cadmium::dynamic::translate::make_EIC<coupledHOmod_in_port2, devstone_atomic_defs::in>(atomic.get()->get_id())
-                        );
-                    }
-
-                    if(idx_row == 0) {
-                        Lcoupled_ics.push_back(
-                                cadmium::dynamic::translate::make_IC<devstone_atomic_defs::out, coupledHOmod_in_port2>(atomic.get()->get_id(), coupled_prev_level->get_id())
-                        );
-                    } else {
-                        auto prev_atomic = atomics_prev_level[idx_column][idx_row-1];
-                        Lcoupled_ics.push_back(
-                                cadmium::dynamic::translate::make_IC<devstone_atomic_defs::out, devstone_atomic_defs::in>(atomic.get()->get_id(), prev_atomic.get()->get_id())
-                        );
-                    }
+
+                if(idx_row == 0) {
+                    couplings.ics.push_back(
+                            cadmium::dynamic::translate::make_IC<devstone_atomic_defs::out, coupledHOmod_in_port2>(atomic_id, coupled_prev_level_id)
+                    );
+                } else {
+                    couplings.ics.push_back(
+                            cadmium::dynamic::translate::make_IC<devstone_atomic_defs::out, devstone_atomic_defs::in>(atomic_id, ids_col[idx_row-1])
+                    );
                 }
+                couplings.submodels.push_back(std::move(models_col[idx_row]));
             }
         }
-        std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> L_coupled = std::make_shared<cadmium::dynamic::modeling::coupled<TIME>>(
-             "L" + std::to_string(level) + "_coupled",
-             Lcoupled_submodels,
+        ModelMatrix().swap(atomics_prev_level);
+        IdMatrix().swap(atomic_ids_by_level[level - 1]);
+    }, 1);
+
+    //chaining the levels, each coupled is a submodel of the next one
+    std::shared_ptr<cadmium::dynamic::modeling::model> last_level_coupled;
+    for (int level=1; level <= depth; level++) {
+        level_couplings& couplings = couplings_by_level[level];
+        if (level > 1) {
+            couplings.submodels.front() = std::move(last_level_coupled);
+        }
+        last_level_coupled = std::make_shared<cadmium::dynamic::modeling::coupled<TIME>>(
+             devstone_ids::coupled(level),
+             std::move(couplings.submodels),
              coupled_in_ports,
              coupled_out_ports,
-             Lcoupled_eics,
-             Lcoupled_eocs,
-             Lcoupled_ics
+             std::move(couplings.eics),
+             std::move(couplings.eocs),
+             std::move(couplings.ics)
         );
-        coupleds_by_level[level] = L_coupled;
     }
 
-    //Create instance of devstone_event_reader
-    std::shared_ptr<cadmium::dynamic::modeling::model> devstone_event_reader1 = cadmium::dynamic::translate::make_dynamic_atomic_model<devstone_event_reader, TIME>("devstone_event_reader1");
-
-    std::shared_ptr<cadmium::dynamic::modeling::model> last_level_coupled = coupleds_by_level[depth];
+    //TOP model conecting the event readers to the input
+    return create_TOP_model<TIME, coupledHOmod_in_port1, coupledHOmod_in_port2>(inputs, last_level_coupled);
+}
 
-    //TOP model conecting a generator of events to the input
-    cadmium::dynamic::modeling::Ports TOP_coupled_in_ports = {};
-    cadmium::dynamic::modeling::Ports TOP_coupled_out_ports = {};
-    cadmium::dynamic::modeling::Models TOP_submodels = {devstone_event_reader1, last_level_coupled};
-    cadmium::dynamic::modeling::EICs TOP_eics = {};
-    cadmium::dynamic::modeling::EOCs TOP_eocs = {};
-    cadmium::dynamic::modeling::ICs TOP_ics = {
-        cadmium::dynamic::translate::make_IC<devstone_event_reader_defs::out,coupledHOmod_in_port1>("devstone_event_reader1",last_level_coupled.get()->get_id()),
-        cadmium::dynamic::translate::make_IC<devstone_event_reader_defs::out,coupledHOmod_in_port2>("devstone_event_reader1",last_level_coupled.get()->get_id())
+std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> create_HOmod_model_from_topology(
+         const topology_view& topology, int ext_cycles, int int_cycles, TIME time_advance, workload work=workload(), const event_inputs& inputs=event_inputs(),
+         const std::shared_ptr<atomic_heap>& heap=nullptr, unsigned int build_threads=1) {
+    // Creates the HOmod model translating a topology built by make_devstone_topology, placing the atomics in the heap if given
+    // The atomics of a heap are allocated in the order of the topology, so they are built on a single thread
+    // Returns a shared_ptr to the TOP model
+    auto make_atomic_devstone = [&ext_cycles, &int_cycles, &time_advance, &work, &heap](const std::string& model_id) -> std::shared_ptr<cadmium::dynamic::modeling::model> {
+        return make_dynamic_atomic_model_in<devstone_atomic, TIME>(heap, model_id, ext_cycles, int_cycles, time_advance, work);
     };
-    std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> TOP_coupled = std::make_shared<cadmium::dynamic::modeling::coupled<TIME>>(
-     "TOP_coupled",
-     TOP_submodels,
-     TOP_coupled_in_ports,
-     TOP_coupled_out_ports,
-     TOP_eics,
-     TOP_eocs,
-     TOP_ics
-    );
-
-    return TOP_coupled;
+    std::shared_ptr<cadmium::dynamic::modeling::model> last_level_coupled = create_coupled_from_topology<TIME, HOmod_topology_ports>(topology, make_atomic_devstone, heap ? 1 : build_threads);
+
+    //TOP model conecting the event readers to the input
+    return create_TOP_model<TIME, coupledHOmod_in_port1, coupledHOmod_in_port2>(inputs, last_level_coupled);
 }
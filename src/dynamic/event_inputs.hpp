@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DYNAMIC_EVENT_INPUTS_HPP
+#define DYNAMIC_EVENT_INPUTS_HPP
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../cadmium-event-reader.hpp"
+#include "../cadmium-event-generator.hpp"
+
+#include <cadmium/modeling/dynamic_model_translator.hpp>
+#include <cadmium/modeling/dynamic_coupled.hpp>
+#include <cadmium/modeling/dynamic_atomic.hpp>
+
+// Sources of the events injected in the DEVStone models by the TOP model
+struct event_inputs {
+    std::vector<std::string> event_lists = {"events.txt"};
+    unsigned int readers = 1; //independent readers, reader i reads event_lists[i % event_lists.size()]
+    std::size_t prefetch_batches = 0; //batches of events parsed ahead by each reader of a text list, 0 disables it
+    unsigned int generators = 0; //synthetic sources, generator i is seeded with generator.seed + i
+    event_generator_config generator;
+};
+
+// Creates the TOP model coupling every event reader and generator to the given input ports of the last level coupled
+template<typename TIME, typename... IN_PORTS>
+std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> create_TOP_model(
+        const event_inputs& inputs, std::shared_ptr<cadmium::dynamic::modeling::model> last_level_coupled) {
+    if (inputs.readers + inputs.generators == 0) throw std::runtime_error("at least one event reader or generator is required");
+    if (inputs.readers > 0 && inputs.event_lists.empty()) throw std::runtime_error("at least one event list is required");
+    unsigned int readers = inputs.readers;
+    unsigned int generators = inputs.generators;
+    std::string last_level_id = last_level_coupled->get_id();
+
+    cadmium::dynamic::modeling::Models TOP_submodels;
+    cadmium::dynamic::modeling::ICs TOP_ics;
+    TOP_submodels.reserve(readers + generators + 1);
+    TOP_ics.reserve((readers + generators) * sizeof...(IN_PORTS));
+    for (unsigned int i = 0; i < readers; i++) {
+        //Create instance of devstone_event_reader
+        std::string reader_id = "devstone_event_reader" + std::to_string(i + 1);
+        const std::string& event_list = inputs.event_lists[i % inputs.event_lists.size()];
+        TOP_submodels.push_back(cadmium::dynamic::translate::make_dynamic_atomic_model<devstone_event_reader, TIME>(reader_id, event_list, inputs.prefetch_batches));
+        (TOP_ics.push_back(cadmium::dynamic::translate::make_IC<devstone_event_reader_defs::out, IN_PORTS>(reader_id, last_level_id)), ...);
+    }
+    for (unsigned int i = 0; i < generators; i++) {
+        //Create instance of devstone_event_generator
+        std::string generator_id = "devstone_event_generator" + std::to_string(i + 1);
+        event_generator_config config = inputs.generator;
+        config.seed += i;
+        TOP_submodels.push_back(cadmium::dynamic::translate::make_dynamic_atomic_model<devstone_event_generator, TIME>(generator_id, config));
+        (TOP_ics.push_back(cadmium::dynamic::translate::make_IC<devstone_event_generator_defs::out, IN_PORTS>(generator_id, last_level_id)), ...);
+    }
+    TOP_submodels.push_back(last_level_coupled);
+
+    //TOP model conecting the generators of events to the input
+    cadmium::dynamic::modeling::Ports TOP_coupled_in_ports = {};
+    cadmium::dynamic::modeling::Ports TOP_coupled_out_ports = {};
+    cadmium::dynamic::modeling::EICs TOP_eics = {};
+    cadmium::dynamic::modeling::EOCs TOP_eocs = {};
+    return std::make_shared<cadmium::dynamic::modeling::coupled<TIME>>(
+     "TOP_coupled",
+     TOP_submodels,
+     TOP_coupled_in_ports,
+     TOP_coupled_out_ports,
+     TOP_eics,
+     TOP_eocs,
+     TOP_ics
+    );
+}
+
+#endif // DYNAMIC_EVENT_INPUTS_HPP
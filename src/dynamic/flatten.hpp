@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DYNAMIC_FLATTEN_HPP
+#define DYNAMIC_FLATTEN_HPP
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "../cadmium-devstone-atomic.hpp"
+#include "../cadmium-event-reader.hpp"
+#include "../cadmium-event-generator.hpp"
+
+#include <cadmium/modeling/dynamic_model_translator.hpp>
+#include <cadmium/modeling/dynamic_coupled.hpp>
+
+// Flattening of the hierarchy of the dynamic DEVStone models.
+// The atomics of every level become submodels of a single coupled model, and every path of couplings
+// from an atomic output port to an atomic input port becomes a direct IC. Messages reach the same input
+// ports the same amount of times, without crossing the EICs and EOCs of the levels.
+
+// A submodel of the hierarchy, with the couplings of the coupled models indexed by their origin
+struct flattening_model {
+    cadmium::dynamic::modeling::model* parent; //nullptr for the root
+    bool is_coupled;
+    std::unordered_map<std::type_index, std::vector<const cadmium::dynamic::modeling::EIC*>> eics_from_port;
+    std::unordered_map<std::string, std::vector<const cadmium::dynamic::modeling::IC*>> ics_from_model;
+    std::unordered_map<std::string, std::vector<const cadmium::dynamic::modeling::EOC*>> eocs_from_model;
+};
+
+// An input port of an atomic reached from an output port
+struct flattening_destination {
+    const std::string* model_id;
+    std::type_index port;
+};
+
+template<typename TIME>
+class hierarchy_flattener {
+public:
+    explicit hierarchy_flattener(const std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>>& root) : _root(root) {
+        std::vector<cadmium::dynamic::modeling::coupled<TIME>*> pending = {root.get()};
+        add_model(root.get(), nullptr);
+        while (!pending.empty()) {
+            cadmium::dynamic::modeling::coupled<TIME>* current = pending.back();
+            pending.pop_back();
+            for (const std::shared_ptr<cadmium::dynamic::modeling::model>& submodel : current->_models) {
+                if (add_model(submodel.get(), current)) {
+                    pending.push_back(as_coupled(submodel.get()));
+                } else {
+                    _atomics.push_back(submodel);
+                }
+            }
+        }
+    }
+
+    std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> flatten() {
+        if (!_root->_input_ports.empty() || !_root->_output_ports.empty()) {
+            throw std::runtime_error("only models without input and output ports, like the TOP models, can be flattened");
+        }
+        cadmium::dynamic::modeling::ICs ics;
+        std::vector<std::type_index> ports;
+        std::vector<flattening_destination> destinations;
+        for (const std::shared_ptr<cadmium::dynamic::modeling::model>& atomic : _atomics) {
+            const std::string& id = _models.find(atomic->get_id())->first;
+            const flattening_model& parent = _models.at(_models.at(id).parent->get_id());
+            ports.clear();
+            auto add_port = [&ports](std::type_index port) {
+                if (std::find(ports.begin(), ports.end(), port) == ports.end()) ports.push_back(port);
+            };
+            auto ics_from = parent.ics_from_model.find(id);
+            if (ics_from != parent.ics_from_model.end()) for (auto ic : ics_from->second) add_port(ic->_link->from_port_type_index());
+            auto eocs_from = parent.eocs_from_model.find(id);
+            if (eocs_from != parent.eocs_from_model.end()) for (auto eoc : eocs_from->second) add_port(eoc->_link->from_port_type_index());
+
+            for (std::type_index port : ports) {
+                destinations.clear();
+                add_outward(id, port, destinations);
+                for (const flattening_destination& destination : destinations) {
+                    ics.push_back(make_flat_IC(port, destination.port, id, *destination.model_id));
+                }
+            }
+        }
+        return std::make_shared<cadmium::dynamic::modeling::coupled<TIME>>(
+             _root->get_id(),
+             _atomics,
+             _root->_input_ports,
+             _root->_output_ports,
+             cadmium::dynamic::modeling::EICs(),
+             cadmium::dynamic::modeling::EOCs(),
+             std::move(ics)
+        );
+    }
+
+private:
+    std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> _root;
+    std::unordered_map<std::string, flattening_model> _models; //by id, ids are unique in the DEVStone models
+    cadmium::dynamic::modeling::Models _atomics;
+
+    static cadmium::dynamic::modeling::coupled<TIME>* as_coupled(cadmium::dynamic::modeling::model* model) {
+        return dynamic_cast<cadmium::dynamic::modeling::coupled<TIME>*>(model);
+    }
+
+    // Registers a model, returns if it is coupled
+    bool add_model(cadmium::dynamic::modeling::model* model, cadmium::dynamic::modeling::model* parent) {
+        auto added = _models.emplace(model->get_id(), flattening_model());
+        if (!added.second) throw std::runtime_error("the model " + model->get_id() + " can not be flattened, its id is repeated");
+        flattening_model& placed = added.first->second;
+        placed.parent = parent;
+        cadmium::dynamic::modeling::coupled<TIME>* coupled = as_coupled(model);
+        placed.is_coupled = (coupled != nullptr);
+        if (coupled) {
+            for (const auto& eic : coupled->_eic) placed.eics_from_port[eic._link->from_port_type_index()].push_back(&eic);
+            for (const auto& ic : coupled->_ic) placed.ics_from_model[ic._from].push_back(&ic);
+            for (const auto& eoc : coupled->_eoc) placed.eocs_from_model[eoc._from].push_back(&eoc);
+        }
+        return placed.is_coupled;
+    }
+
+    // Input ports of atomics reached from the output port of a model, through ICs or going up through EOCs
+    void add_outward(const std::string& from, std::type_index port, std::vector<flattening_destination>& destinations) {
+        cadmium::dynamic::modeling::model* parent = _models.at(from).parent;
+        if (parent == nullptr) return; //the root has no output ports
+        const std::string& parent_id = _models.find(parent->get_id())->first;
+        const flattening_model& coupled = _models.at(parent_id);
+        auto ics = coupled.ics_from_model.find(from);
+        if (ics != coupled.ics_from_model.end()) {
+            for (const cadmium::dynamic::modeling::IC* ic : ics->second) {
+                if (ic->_link->from_port_type_index() != port) continue;
+                add_inward(ic->_to, ic->_link->to_port_type_index(), destinations);
+            }
+        }
+        auto eocs = coupled.eocs_from_model.find(from);
+        if (eocs != coupled.eocs_from_model.end()) {
+            for (const cadmium::dynamic::modeling::EOC* eoc : eocs->second) {
+                if (eoc->_link->from_port_type_index() != port) continue;
+                add_outward(parent_id, eoc->_link->to_port_type_index(), destinations);
+            }
+        }
+    }
+
+    // Input ports of atomics reached from the input port of a model, going down through EICs
+    void add_inward(const std::string& to, std::type_index port, std::vector<flattening_destination>& destinations) {
+        auto placed = _models.find(to);
+        if (!placed->second.is_coupled) {
+            destinations.push_back({&placed->first, port});
+            return;
+        }
+        auto eics = placed->second.eics_from_port.find(port);
+        if (eics == placed->second.eics_from_port.end()) return;
+        for (const cadmium::dynamic::modeling::EIC* eic : eics->second) {
+            add_inward(eic->_to, eic->_link->to_port_type_index(), destinations);
+        }
+    }
+
+    // The port types are only known at run time, so the ICs are made for the ports of the DEVStone models
+    static cadmium::dynamic::modeling::IC make_flat_IC(std::type_index from_port, std::type_index to_port, const std::string& from, const std::string& to) {
+        if (to_port == typeid(devstone_atomic_defs::in)) {
+            if (from_port == typeid(devstone_atomic_defs::out)) {
+                return cadmium::dynamic::translate::make_IC<devstone_atomic_defs::out, devstone_atomic_defs::in>(from, to);
+            }
+            if (from_port == typeid(devstone_event_reader_defs::out)) {
+                return cadmium::dynamic::translate::make_IC<devstone_event_reader_defs::out, devstone_atomic_defs::in>(from, to);
+            }
+            if (from_port == typeid(devstone_event_generator_defs::out)) {
+                return cadmium::dynamic::translate::make_IC<devstone_event_generator_defs::out, devstone_atomic_defs::in>(from, to);
+            }
+        }
+        throw std::runtime_error("the coupling from " + from + " to " + to + " does not connect DEVStone atomics, readers or generators");
+    }
+};
+
+// Builds a single level coupled model equivalent to the model
+template<typename TIME>
+std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> flatten_hierarchy(const std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>>& model) {
+    return hierarchy_flattener<TIME>(model).flatten();
+}
+
+#endif // DYNAMIC_FLATTEN_HPP
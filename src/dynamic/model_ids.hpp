@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DYNAMIC_MODEL_IDS_HPP
+#define DYNAMIC_MODEL_IDS_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <string>
+#include <vector>
+
+// Identifiers of the DEVStone models, each one is formatted once in a reused buffer and then
+// passed by reference to the model and to all of its couplings.
+// The names are the historical ones, models exported with DEVSDiagrammer keep their ids.
+
+namespace devstone_ids {
+
+    // Appends the decimal representation of value to the buffer
+    void append_number(std::string& buffer, unsigned int value) {
+        char digits[16];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr);
+    }
+
+    // Formats an id of an atomic in a buffer on the stack, so the id is allocated once with its exact size
+    class atomic_id_buffer {
+        char _chars[sizeof("devstone_atomic_L") + 3 * 11];
+        char* _end;
+
+    public:
+        atomic_id_buffer(unsigned int level, unsigned int index) {
+            const char prefix[] = "devstone_atomic_L";
+            _end = std::copy(prefix, prefix + sizeof(prefix) - 1, _chars);
+            append(level);
+            append('_');
+            append(index);
+        }
+
+        void append(unsigned int value) {
+            _end = std::to_chars(_end, _chars + sizeof(_chars), value).ptr;
+        }
+
+        void append(char c) {
+            *_end++ = c;
+        }
+
+        std::string str() const {
+            return std::string(_chars, _end - _chars);
+        }
+    };
+
+    // "devstone_atomic_L<level>_<index>"
+    std::string atomic(unsigned int level, unsigned int index) {
+        return atomic_id_buffer(level, index).str();
+    }
+
+    // "devstone_atomic_L<level>_<column>,<row>"
+    std::string column_atomic(unsigned int level, unsigned int column, unsigned int row) {
+        atomic_id_buffer id(level, column);
+        id.append(',');
+        id.append(row);
+        return id.str();
+    }
+
+    // "devstone_atomic_L<level>_<column>,<row>" for every row of a HOmod column
+    std::vector<std::string> column_atomics(unsigned int level, unsigned int column, unsigned int rows) {
+        std::vector<std::string> ids;
+        ids.reserve(rows);
+        std::string buffer = "devstone_atomic_L";
+        append_number(buffer, level);
+        buffer += '_';
+        append_number(buffer, column);
+        buffer += ',';
+        std::size_t prefix = buffer.size();
+        for (unsigned int row = 0; row < rows; row++) {
+            buffer.resize(prefix);
+            append_number(buffer, row);
+            ids.emplace_back(buffer);
+        }
+        return ids;
+    }
+
+    // "L<level>_coupled"
+    std::string coupled(unsigned int level) {
+        std::string id = "L";
+        append_number(id, level);
+        id += "_coupled";
+        return id;
+    }
+}
+
+#endif // DYNAMIC_MODEL_IDS_HPP
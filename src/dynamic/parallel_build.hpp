@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DYNAMIC_PARALLEL_BUILD_HPP
+#define DYNAMIC_PARALLEL_BUILD_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cadmium/modeling/dynamic_coupled.hpp>
+
+// Helpers for building the levels of the dynamic DEVStone models in parallel.
+// Work items write only their own slots of vectors sized in advance, so the models built are the
+// same whatever the amount of threads.
+
+// Threads to use for a requested amount, 0 means one per hardware thread
+unsigned int build_threads_for(unsigned int requested) {
+    if (requested > 0) return requested;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Runs f(i) for every i in [begin, end) using up to threads threads, the calling thread included.
+// Indexes are taken in blocks of grain. The first exception thrown by f is rethrown.
+template<typename FUNCTION>
+void parallel_for(std::size_t begin, std::size_t end, unsigned int threads, FUNCTION&& f, std::size_t grain = 64) {
+    if (begin >= end) return;
+    std::size_t blocks = (end - begin + grain - 1) / grain;
+    threads = static_cast<unsigned int>(std::min<std::size_t>(std::max(threads, 1u), blocks));
+    if (threads == 1) {
+        for (std::size_t i = begin; i < end; i++) f(i);
+        return;
+    }
+
+    std::atomic<std::size_t> next_block{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        try {
+            for (std::size_t block = next_block++; block < blocks; block = next_block++) {
+                std::size_t first = begin + block * grain;
+                std::size_t last = std::min(end, first + grain);
+                for (std::size_t i = first; i < last; i++) f(i);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) error = std::current_exception();
+            next_block = blocks; //the other workers stop after their current block
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned int t = 1; t < threads; t++) workers.emplace_back(worker);
+    worker();
+    for (std::thread& w : workers) w.join();
+    if (error) std::rethrow_exception(error);
+}
+
+// Submodels and couplings of a level. The first submodel is left empty for the coupled of the
+// previous level, which is only known once the levels below are built.
+struct level_couplings {
+    cadmium::dynamic::modeling::Models submodels;
+    cadmium::dynamic::modeling::EICs eics;
+    cadmium::dynamic::modeling::EOCs eocs;
+    cadmium::dynamic::modeling::ICs ics;
+};
+
+#endif // DYNAMIC_PARALLEL_BUILD_HPP
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DYNAMIC_SWEEP_HPP
+#define DYNAMIC_SWEEP_HPP
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "../allocation-layer.hpp"
+#include "../cadmium-devstone-atomic.hpp"
+#include "../topology.hpp"
+#include "event_inputs.hpp"
+#include "topology_adapter.hpp"
+
+#include <cadmium/modeling/dynamic_coupled.hpp>
+#include <cadmium/engine/pdevs_dynamic_runner.hpp>
+#include <cadmium/logger/common_loggers.hpp>
+
+// Sweeps of DEVStones over a range of widths and depths.
+// For each width the models grow one level at a time, the DEVStone of depth d being the last level of
+// the one of depth d + 1, so every level is built once per width instead of once per point.
+
+struct devstone_sweep {
+    unsigned int min_width;
+    unsigned int max_width;
+    unsigned int min_depth;
+    unsigned int max_depth;
+};
+
+// Resets the state of every DEVStone atomic of a model, leaving it as constructed
+template<typename TIME>
+void reset_devstone_states(const std::shared_ptr<cadmium::dynamic::modeling::model>& model) {
+    std::vector<cadmium::dynamic::modeling::model*> pending = {model.get()};
+    while (!pending.empty()) {
+        cadmium::dynamic::modeling::model* current = pending.back();
+        pending.pop_back();
+        if (auto coupled = dynamic_cast<cadmium::dynamic::modeling::coupled<TIME>*>(current)) {
+            for (const auto& submodel : coupled->_models) pending.push_back(submodel.get());
+        } else if (auto atomic = dynamic_cast<devstone_atomic_base<TIME>*>(current)) {
+            atomic->state = typename devstone_atomic_base<TIME>::state_type();
+        }
+    }
+}
+
+// Simulates every point of the sweep, printing a line of timings per point.
+// The simulations run until passivation, or until stop_time when it is finite.
+// Allocations are counted in the phase of each step, adding up the points of the sweep.
+template<typename TIME, typename PORTS, typename... IN_PORTS>
+void run_devstone_sweep(devstone_kind kind, const devstone_sweep& sweep, typename dynamic_topology_translator<TIME, PORTS>::atomic_factory make_atomic,
+                        const event_inputs& inputs, double stop_time, std::ostream& os) {
+    using hclock = std::chrono::high_resolution_clock;
+    auto seconds = [](hclock::duration d) { return std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>(d).count(); };
+
+    for (unsigned int width = sweep.min_width; width <= sweep.max_width; width++) {
+        auto start = hclock::now();
+        start_allocation_phase(construction_phase);
+        devstone_topology topology = make_devstone_topology(kind, width, sweep.max_depth);
+        dynamic_topology_translator<TIME, PORTS> translator(topology, make_atomic);
+        auto topology_built = hclock::now();
+        os << "width: " << width << " time building the topology: " << seconds(topology_built - start) << std::endl;
+
+        //the levels grown for depths out of the sweep are timed with the first point
+        auto point_start = hclock::now();
+        for (unsigned int depth = 1; depth <= sweep.max_depth; depth++) {
+            start_allocation_phase(construction_phase);
+            std::shared_ptr<cadmium::dynamic::modeling::model> last_level_coupled = translator.translate(depth);
+            if (depth < sweep.min_depth) continue;
+            reset_devstone_states<TIME>(last_level_coupled);
+            std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> TOP_coupled = create_TOP_model<TIME, IN_PORTS...>(inputs, last_level_coupled);
+            auto model_built = hclock::now();
+            start_allocation_phase(initialization_phase);
+
+            cadmium::dynamic::engine::runner<TIME, cadmium::logger::not_logger> r(TOP_coupled, 0.0);
+            auto model_init = hclock::now();
+            start_allocation_phase(simulation_phase);
+            if (std::isfinite(stop_time)) {
+                r.run_until(stop_time);
+            } else {
+                r.run_until_passivate();
+            }
+            auto finished_simulation = hclock::now();
+            start_allocation_phase(reporting_phase);
+
+            os << "width: " << width << " depth: " << depth
+               << " atomics: " << devstone_atomics(kind, width, depth)
+               << " time constructing the models: " << seconds(model_built - point_start)
+               << " time initializing the models: " << seconds(model_init - model_built)
+               << " time running simulation: " << seconds(finished_simulation - model_init) << std::endl;
+            point_start = hclock::now();
+        }
+    }
+}
+
+#endif // DYNAMIC_SWEEP_HPP
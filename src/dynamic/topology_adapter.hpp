@@ -0,0 +1,232 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DYNAMIC_TOPOLOGY_ADAPTER_HPP
+#define DYNAMIC_TOPOLOGY_ADAPTER_HPP
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../topology.hpp"
+#include "../heap-layout.hpp"
+#include "../cadmium-devstone-atomic.hpp"
+#include "model_ids.hpp"
+#include "parallel_build.hpp"
+
+#include <cadmium/modeling/dynamic_model_translator.hpp>
+#include <cadmium/modeling/dynamic_atomic.hpp>
+#include <cadmium/modeling/dynamic_coupled.hpp>
+
+// Translation of a DEVStone topology to Cadmium dynamic models.
+// The port types of the coupled models are given by a PORTS struct with in1, in2, out1 and out2 types,
+// kinds with a single port of a direction repeat it as the second one, which the topology never uses.
+
+template<typename PORT>
+struct topology_port_type {
+    using type = PORT;
+};
+
+// Calls f with the type of an input port
+template<typename PORTS, typename FUNCTION>
+void with_input_port_type(topology_port port, FUNCTION&& f) {
+    switch (port) {
+        case atomic_in: f(topology_port_type<devstone_atomic_defs::in>()); return;
+        case coupled_in1: f(topology_port_type<typename PORTS::in1>()); return;
+        case coupled_in2: f(topology_port_type<typename PORTS::in2>()); return;
+        default: throw std::runtime_error("an input port was expected in the coupling");
+    }
+}
+
+// Calls f with the type of an output port
+template<typename PORTS, typename FUNCTION>
+void with_output_port_type(topology_port port, FUNCTION&& f) {
+    switch (port) {
+        case atomic_out: f(topology_port_type<devstone_atomic_defs::out>()); return;
+        case coupled_out1: f(topology_port_type<typename PORTS::out1>()); return;
+        case coupled_out2: f(topology_port_type<typename PORTS::out2>()); return;
+        default: throw std::runtime_error("an output port was expected in the coupling");
+    }
+}
+
+// Id of an atomic of the topology
+std::string topology_atomic_id(const topology_atomic& atomic) {
+    if (atomic.row == topology_atomic::no_row) {
+        return devstone_ids::atomic(atomic.level, atomic.column);
+    }
+    return devstone_ids::column_atomic(atomic.level, atomic.column, atomic.row);
+}
+
+// Creates an atomic as make_dynamic_atomic_model does, in the heap when there is one
+template<template<typename T> class ATOMIC, typename TIME, typename... Args>
+std::shared_ptr<cadmium::dynamic::modeling::model> make_dynamic_atomic_model_in(const std::shared_ptr<atomic_heap>& heap, const std::string& model_id, Args&&... args) {
+    if (!heap) return cadmium::dynamic::translate::make_dynamic_atomic_model<ATOMIC, TIME>(model_id, std::forward<Args>(args)...);
+    return make_atomic_in<cadmium::dynamic::modeling::atomic<ATOMIC, TIME, Args...>>(heap, model_id, std::forward<Args>(args)...);
+}
+
+// Translates the coupled models of a topology level by level. The levels already translated are reused,
+// since the coupled of a level does not depend on the depth, so the DEVStones of every depth up to the
+// one of the topology are obtained growing the same models.
+// As the generators do, the atomics and the couplings of the levels are built on threads threads and the
+// levels are chained afterwards, atomics must only be built on more than one thread if make_atomic allows it.
+template<typename TIME, typename PORTS>
+class dynamic_topology_translator {
+public:
+    using atomic_factory = std::function<std::shared_ptr<cadmium::dynamic::modeling::model>(const std::string&)>;
+
+    dynamic_topology_translator(const topology_view& topology, atomic_factory make_atomic, unsigned int threads=1)
+        : _topology(topology), _make_atomic(std::move(make_atomic)), _threads(threads) {
+        _coupled_in_ports = {typeid(typename PORTS::in1)};
+        if (coupled_input_ports(topology.kind) > 1) _coupled_in_ports.push_back(typeid(typename PORTS::in2));
+        _coupled_out_ports = {typeid(typename PORTS::out1)};
+        if (coupled_output_ports(topology.kind) > 1) _coupled_out_ports.push_back(typeid(typename PORTS::out2));
+        _atomics.reserve(topology.atomics.size());
+        _coupled_ids.reserve(topology.coupleds.size());
+        _coupleds.reserve(topology.coupleds.size());
+    }
+
+    // Returns the coupled model of the level, which is the last level of the DEVStone of that depth
+    std::shared_ptr<cadmium::dynamic::modeling::model> translate(unsigned int level) {
+        if (level < 1 || level > _topology.coupleds.size()) throw std::runtime_error("the topology does not have the level " + std::to_string(level));
+        if (_coupleds.size() < level) {
+            translate_levels(level);
+        }
+        return _coupleds[level - 1];
+    }
+
+private:
+    topology_view _topology;
+    atomic_factory _make_atomic;
+    unsigned int _threads;
+    cadmium::dynamic::modeling::Ports _coupled_in_ports;
+    cadmium::dynamic::modeling::Ports _coupled_out_ports;
+    cadmium::dynamic::modeling::Models _atomics;
+    std::vector<std::string> _coupled_ids;
+    cadmium::dynamic::modeling::Models _coupleds;
+
+    //ids of the atomics are formatted again for every coupling instead of keeping one per atomic alive
+    std::string id(topology_model model) const {
+        return (model.is_coupled ? _coupled_ids[model.index] : topology_atomic_id(_topology.atomics[model.index]));
+    }
+
+    // Translates the levels after the last one translated up to last_level
+    void translate_levels(unsigned int last_level) {
+        std::size_t first_level = _coupleds.size() + 1;
+
+        //the submodels of a level are the atomics of the previous one, which are sorted by level
+        std::size_t first_atomic = _atomics.size();
+        std::size_t last_atomic = first_atomic;
+        while (last_atomic < _topology.atomics.size() && _topology.atomics[last_atomic].level < last_level) {
+            last_atomic++;
+        }
+        _atomics.resize(last_atomic);
+        parallel_for(first_atomic, last_atomic, _threads, [&](std::size_t a) {
+            _atomics[a] = _make_atomic(topology_atomic_id(_topology.atomics[a]));
+        }, 256);
+        for (std::size_t level = first_level; level <= last_level; level++) {
+            _coupled_ids.push_back(devstone_ids::coupled(level));
+        }
+
+        //couplings only refer to the ids, so the levels are independent until they are chained
+        std::vector<level_couplings> levels(last_level - first_level + 1);
+        parallel_for(first_level, std::size_t(last_level) + 1, _threads, [&](std::size_t level) {
+            translate_couplings(_topology.coupleds[level - 1], levels[level - first_level]);
+        }, 1);
+
+        //atomics are moved to their coupled model, coupled models are kept to be the last level of a shallower DEVStone
+        for (std::size_t level = first_level; level <= last_level; level++) {
+            const topology_coupled& coupled = _topology.coupleds[level - 1];
+            level_couplings& couplings = levels[level - first_level];
+            couplings.submodels.reserve(coupled.submodels);
+            for (std::uint32_t s = coupled.first_submodel; s < coupled.first_submodel + coupled.submodels; s++) {
+                topology_model submodel = _topology.submodels[s];
+                if (submodel.is_coupled) {
+                    couplings.submodels.push_back(_coupleds[submodel.index]);
+                } else {
+                    couplings.submodels.push_back(std::move(_atomics[submodel.index]));
+                }
+            }
+            _coupleds.push_back(std::make_shared<cadmium::dynamic::modeling::coupled<TIME>>(
+                 _coupled_ids[level - 1],
+                 std::move(couplings.submodels),
+                 _coupled_in_ports,
+                 _coupled_out_ports,
+                 std::move(couplings.eics),
+                 std::move(couplings.eocs),
+                 std::move(couplings.ics)
+            ));
+        }
+    }
+
+    void translate_couplings(const topology_coupled& coupled, level_couplings& couplings) const {
+        std::size_t counts[3] = {0, 0, 0};
+        for (std::uint32_t i = coupled.first_coupling; i < coupled.first_coupling + coupled.couplings; i++) {
+            counts[_topology.couplings[i].kind]++;
+        }
+        couplings.eics.reserve(counts[topology_eic]);
+        couplings.eocs.reserve(counts[topology_eoc]);
+        couplings.ics.reserve(counts[topology_ic]);
+
+        for (std::uint32_t i = coupled.first_coupling; i < coupled.first_coupling + coupled.couplings; i++) {
+            const topology_coupling& coupling = _topology.couplings[i];
+            switch (coupling.kind) {
+                case topology_eic:
+                    with_input_port_type<PORTS>(coupling.from_port, [&](auto from) {
+                        with_input_port_type<PORTS>(coupling.to_port, [&](auto to) {
+                            couplings.eics.push_back(cadmium::dynamic::translate::make_EIC<typename decltype(from)::type, typename decltype(to)::type>(id(coupling.to)));
+                        });
+                    });
+                    break;
+                case topology_eoc:
+                    with_output_port_type<PORTS>(coupling.from_port, [&](auto from) {
+                        with_output_port_type<PORTS>(coupling.to_port, [&](auto to) {
+                            couplings.eocs.push_back(cadmium::dynamic::translate::make_EOC<typename decltype(from)::type, typename decltype(to)::type>(id(coupling.from)));
+                        });
+                    });
+                    break;
+                case topology_ic:
+                    with_output_port_type<PORTS>(coupling.from_port, [&](auto from) {
+                        with_input_port_type<PORTS>(coupling.to_port, [&](auto to) {
+                            couplings.ics.push_back(cadmium::dynamic::translate::make_IC<typename decltype(from)::type, typename decltype(to)::type>(id(coupling.from), id(coupling.to)));
+                        });
+                    });
+                    break;
+            }
+        }
+    }
+};
+
+// Creates the coupled model of the last level of the topology on threads threads, atomics are created calling
+// make_atomic with their ids
+template<typename TIME, typename PORTS, typename MAKE_ATOMIC>
+std::shared_ptr<cadmium::dynamic::modeling::model> create_coupled_from_topology(const topology_view& topology, MAKE_ATOMIC&& make_atomic, unsigned int threads=1) {
+    if (topology.coupleds.empty()) throw std::runtime_error("the topology has no coupled models");
+    dynamic_topology_translator<TIME, PORTS> translator(topology, std::forward<MAKE_ATOMIC>(make_atomic), threads);
+    return translator.translate(topology.depth);
+}
+
+#endif // DYNAMIC_TOPOLOGY_ADAPTER_HPP
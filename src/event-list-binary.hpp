@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef EVENT_LIST_BINARY_HPP
+#define EVENT_LIST_BINARY_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Binary event lists: a fixed size header followed by (time, value) records sorted by time.
+ * Records have a fixed width and the natural alignment of their fields, so the list is used
+ * in place through mmap, without parsing. Fields are stored in the byte order of the host.
+ *
+ * They are produced from the text format ("time value" per line) with: devstone-events convert
+ */
+
+const char event_list_magic[8] = {'D', 'E', 'V', 'S', 'E', 'V', 'T', 'S'};
+const std::uint32_t event_list_version = 1;
+
+struct event_list_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t record_size;
+    std::uint64_t records;
+};
+
+struct event_record {
+    double time;
+    std::int32_t value;
+    std::int32_t reserved; //padding, always 0
+};
+
+static_assert(sizeof(event_list_header) % alignof(event_record) == 0, "records must be aligned after the header");
+
+// Returns true if the file starts with the magic of a binary event list
+bool is_binary_event_list(const std::string& path) {
+    std::ifstream is(path, std::ios_base::binary);
+    char magic[sizeof(event_list_magic)];
+    return is.read(magic, sizeof(magic)) && std::memcmp(magic, event_list_magic, sizeof(magic)) == 0;
+}
+
+event_list_header make_event_list_header(std::uint64_t records) {
+    event_list_header header;
+    std::memcpy(header.magic, event_list_magic, sizeof(event_list_magic));
+    header.version = event_list_version;
+    header.record_size = sizeof(event_record);
+    header.records = records;
+    return header;
+}
+
+void write_event_list_header(std::ostream& os, std::uint64_t records) {
+    event_list_header header = make_event_list_header(records);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void write_event_record(std::ostream& os, double time, std::int32_t value) {
+    event_record record{time, value, 0};
+    os.write(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
+// A binary event list mapped in memory, records are only valid while the object is alive
+class mapped_event_list {
+    void* _data = MAP_FAILED;
+    std::size_t _size = 0;
+    const event_record* _begin = nullptr;
+    const event_record* _end = nullptr;
+
+public:
+    explicit mapped_event_list(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("failed to open events file: " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(event_list_header)) {
+            close(fd);
+            throw std::runtime_error("not a binary event list: " + path);
+        }
+        _size = static_cast<std::size_t>(st.st_size);
+        _data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (_data == MAP_FAILED) throw std::runtime_error("failed to map events file: " + path);
+        madvise(_data, _size, MADV_SEQUENTIAL);
+
+        const event_list_header* header = static_cast<const event_list_header*>(_data);
+        if (std::memcmp(header->magic, event_list_magic, sizeof(event_list_magic)) != 0
+            || header->version != event_list_version
+            || header->record_size != sizeof(event_record)
+            || header->records > (_size - sizeof(event_list_header)) / sizeof(event_record)) {
+            munmap(_data, _size);
+            throw std::runtime_error("not a binary event list, or truncated: " + path);
+        }
+        _begin = reinterpret_cast<const event_record*>(static_cast<const char*>(_data) + sizeof(event_list_header));
+        _end = _begin + header->records;
+    }
+
+    mapped_event_list(const mapped_event_list&) = delete;
+    mapped_event_list& operator=(const mapped_event_list&) = delete;
+
+    ~mapped_event_list() {
+        if (_data != MAP_FAILED) munmap(_data, _size);
+    }
+
+    const event_record* begin() const { return _begin; }
+    const event_record* end() const { return _end; }
+    std::size_t size() const { return static_cast<std::size_t>(_end - _begin); }
+};
+
+#endif // EVENT_LIST_BINARY_HPP
@@ -0,0 +1,310 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef EVENT_LIST_SORT_HPP
+#define EVENT_LIST_SORT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "event-list-binary.hpp"
+#include "event-text-parser.hpp"
+
+/**
+ * External merge sort of event lists larger than the memory, used by devstone-events sort.
+ *
+ * The input, text or binary and in any order, is read in runs filling the memory budget. Each run
+ * is sorted and written to a temporary file, then the runs are merged into the output, in several
+ * passes if there are too many runs to merge them at once with the budget.
+ * Events at the same time keep their input order, unless duplicates are removed without coalescing:
+ * then they are ordered by value so duplicates are adjacent. Coalescing keeps the first event of each
+ * time in the input, which also drops its duplicates.
+ * Temporary runs are removed when merged, and the ones left are removed if the sort fails.
+ */
+
+struct event_sort_options {
+    std::size_t memory_bytes = std::size_t(256) << 20;
+    bool dedup = false; //drops repeated (time, value) events
+    bool coalesce = false; //keeps only the first event of each time
+    bool binary_output = true;
+    std::string temp_prefix; //temporary runs are named temp_prefix.runN
+};
+
+struct event_sort_stats {
+    std::uint64_t records_read = 0;
+    std::uint64_t records_written = 0;
+    std::uint64_t runs = 0;
+    std::uint64_t merge_passes = 0;
+};
+
+// Calls f(time, value) for every event of a text or binary list, in file order
+template<typename FUNCTION>
+void for_each_event(const std::string& path, FUNCTION&& f) {
+    if (is_binary_event_list(path)) {
+        mapped_event_list events(path);
+        for (const event_record& record : events) f(record.time, record.value);
+    } else {
+        event_text_parser parser(path, event_text_parser::default_chunk_bytes, false);
+        for (; parser.has_next(); parser.pop()) f(parser.next_time(), parser.next_value());
+    }
+}
+
+// Writes an event list in text or binary format
+class event_list_writer {
+public:
+    event_list_writer(const std::string& path, bool binary)
+    : path(path), binary(binary), os(path, binary ? std::ios_base::binary : std::ios_base::out) {
+        if (!os.good()) throw std::runtime_error("failed to open output file: " + path);
+        if (binary) {
+            write_event_list_header(os, 0); //the amount of records is known at the end
+        } else {
+            os << std::setprecision(std::numeric_limits<double>::max_digits10);
+        }
+    }
+
+    void write(double time, std::int32_t value) {
+        if (binary) {
+            write_event_record(os, time, value);
+        } else {
+            os << time << ' ' << value << '\n';
+        }
+        records++;
+    }
+
+    // Returns the number of records written
+    std::uint64_t finish() {
+        if (binary) {
+            os.seekp(0);
+            write_event_list_header(os, records);
+        }
+        os.flush();
+        if (!os.good()) throw std::runtime_error("failed writing output file: " + path);
+        return records;
+    }
+
+private:
+    std::string path;
+    bool binary;
+    std::ofstream os;
+    std::uint64_t records = 0;
+};
+
+// Removes the temporary runs still left when destroyed, so none outlives a failed sort
+class temporary_runs {
+public:
+    temporary_runs() = default;
+    temporary_runs(const temporary_runs&) = delete;
+    temporary_runs& operator=(const temporary_runs&) = delete;
+
+    ~temporary_runs() {
+        for (const std::string& run : runs) std::remove(run.c_str());
+    }
+
+    // Returns the run, which is removed later if it still exists
+    std::string add(const std::string& run) {
+        runs.push_back(run);
+        return run;
+    }
+
+private:
+    std::vector<std::string> runs;
+};
+
+// Files that can be open at once by the process, 0 if there is no limit
+std::size_t open_files_limit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) return 0;
+    return static_cast<std::size_t>(limit.rlim_cur);
+}
+
+class event_list_sorter {
+public:
+    explicit event_list_sorter(const event_sort_options& options) : options(options) {
+        if (this->options.memory_bytes < min_memory_bytes) this->options.memory_bytes = min_memory_bytes;
+    }
+
+    event_sort_stats sort(const std::string& input, const std::string& output) {
+        stats = event_sort_stats();
+        temporary_runs temporaries;
+        std::vector<std::string> runs = write_runs(input, temporaries);
+        stats.runs = runs.size();
+
+        //merging in passes while the runs do not fit the budget, or the files that can be open, at once
+        std::size_t fan_in = std::max<std::size_t>(2, options.memory_bytes / min_run_buffer_bytes - 1);
+        std::size_t files_limit = open_files_limit();
+        if (files_limit > 0) {
+            fan_in = std::min(fan_in, std::max<std::size_t>(2, files_limit > reserved_files ? files_limit - reserved_files : 0));
+        }
+        std::size_t next_run = runs.size();
+        while (runs.size() > fan_in) {
+            std::vector<std::string> merged;
+            for (std::size_t first = 0; first < runs.size(); first += fan_in) {
+                std::vector<std::string> group(runs.begin() + first, runs.begin() + std::min(first + fan_in, runs.size()));
+                std::string run = temporaries.add(run_name(next_run++));
+                std::ofstream os(run, std::ios_base::binary);
+                merge(group, [&os](const event_record& record) {
+                    os.write(reinterpret_cast<const char*>(&record), sizeof(record));
+                });
+                if (!os.good()) throw std::runtime_error("failed writing temporary file: " + run);
+                merged.push_back(run);
+            }
+            runs = std::move(merged);
+            stats.merge_passes++;
+        }
+
+        event_list_writer writer(output, options.binary_output);
+        merge(runs, [&writer](const event_record& record) { writer.write(record.time, record.value); });
+        stats.merge_passes++;
+        stats.records_written = writer.finish();
+        return stats;
+    }
+
+private:
+    static constexpr std::size_t min_memory_bytes = std::size_t(1) << 20;
+    static constexpr std::size_t min_run_buffer_bytes = std::size_t(64) << 10;
+    //standard streams, input, output and the run being written, with room for the files of the caller
+    static constexpr std::size_t reserved_files = 16;
+
+    event_sort_options options;
+    event_sort_stats stats;
+
+    std::string run_name(std::size_t run) const {
+        return options.temp_prefix + ".run" + std::to_string(run);
+    }
+
+    // Order of the output, the run index breaks ties to keep the input order
+    bool before(const event_record& a, const event_record& b) const {
+        if (a.time != b.time) return a.time < b.time;
+        return options.dedup && !options.coalesce && a.value < b.value;
+    }
+
+    // True if b is dropped after a by dedup or coalesce
+    bool drops(const event_record& a, const event_record& b) const {
+        return a.time == b.time && (options.coalesce || (options.dedup && a.value == b.value));
+    }
+
+    std::vector<std::string> write_runs(const std::string& input, temporary_runs& temporaries) {
+        std::vector<std::string> runs;
+        std::vector<event_record> records;
+        //half of the budget, stable_sort may take as much for its buffer
+        records.reserve(options.memory_bytes / (2 * sizeof(event_record)));
+        auto flush = [&]() {
+            if (records.empty()) return;
+            std::stable_sort(records.begin(), records.end(),
+                             [this](const event_record& a, const event_record& b) { return before(a, b); });
+            auto last = std::unique(records.begin(), records.end(),
+                                    [this](const event_record& a, const event_record& b) { return drops(a, b); });
+            std::string run = temporaries.add(run_name(runs.size()));
+            std::ofstream os(run, std::ios_base::binary);
+            os.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>((last - records.begin()) * sizeof(event_record)));
+            if (!os.good()) throw std::runtime_error("failed writing temporary file: " + run);
+            runs.push_back(run);
+            records.clear();
+        };
+        for_each_event(input, [&](double time, std::int32_t value) {
+            records.push_back(event_record{time, value, 0});
+            stats.records_read++;
+            if (records.size() == records.capacity()) flush();
+        });
+        flush();
+        return runs;
+    }
+
+    // Sequential reader of a temporary run with its own buffer
+    struct run_reader {
+        std::ifstream is;
+        std::vector<event_record> buffer;
+        std::size_t position = 0;
+        std::size_t size = 0;
+
+        run_reader(const std::string& run, std::size_t records) : is(run, std::ios_base::binary), buffer(records) {
+            if (!is.good()) throw std::runtime_error("failed to open temporary file: " + run);
+        }
+
+        // Next record, false at the end of the run
+        bool next(event_record& record) {
+            if (position == size) {
+                is.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(event_record)));
+                size = static_cast<std::size_t>(is.gcount()) / sizeof(event_record);
+                position = 0;
+                if (size == 0) return false;
+            }
+            record = buffer[position++];
+            return true;
+        }
+    };
+
+    // Merges the runs, writing the records in order through write, and removes the runs
+    template<typename WRITE>
+    void merge(const std::vector<std::string>& runs, WRITE&& write) {
+        std::size_t buffer_records = std::max(min_run_buffer_bytes, options.memory_bytes / (runs.size() + 1)) / sizeof(event_record);
+        std::vector<std::unique_ptr<run_reader>> readers;
+        readers.reserve(runs.size());
+        for (const std::string& run : runs) readers.emplace_back(new run_reader(run, buffer_records));
+
+        using head = std::pair<event_record, std::size_t>;
+        auto after = [this](const head& a, const head& b) {
+            if (before(b.first, a.first)) return true;
+            if (before(a.first, b.first)) return false;
+            return a.second > b.second;
+        };
+        std::priority_queue<head, std::vector<head>, decltype(after)> heads(after);
+        for (std::size_t i = 0; i < readers.size(); i++) {
+            event_record record;
+            if (readers[i]->next(record)) heads.emplace(record, i);
+        }
+
+        bool written = false;
+        event_record last{};
+        while (!heads.empty()) {
+            head top = heads.top();
+            heads.pop();
+            if (!written || !drops(last, top.first)) {
+                write(top.first);
+                last = top.first;
+                written = true;
+            }
+            event_record record;
+            if (readers[top.second]->next(record)) heads.emplace(record, top.second);
+        }
+        readers.clear();
+        for (const std::string& run : runs) std::remove(run.c_str());
+    }
+};
+
+#endif // EVENT_LIST_SORT_HPP
@@ -0,0 +1,229 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef EVENT_PREFETCHER_HPP
+#define EVENT_PREFETCHER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "event-text-parser.hpp"
+
+/**
+ * Parsing of text event lists in a background thread.
+ *
+ * A producer thread parses the list into batches, all the events sharing a timestamp, and
+ * publishes them in a single-producer/single-consumer ring of fixed capacity. The consumer takes
+ * the values of a batch by swapping vectors with the ring slot, so the vectors are reused and no
+ * message is copied. When the ring is full the producer waits, which bounds the memory used to
+ * the capacity of the ring, and when it is empty the consumer waits. Waiting threads sleep on a
+ * condition variable instead of spinning, and are only signalled when the ring stops being full
+ * or empty while they wait, so the data path takes no lock. Parse errors are rethrown to the
+ * consumer when it reaches them.
+ */
+
+struct event_batch {
+    double time = 0;
+    std::vector<std::int32_t> values;
+};
+
+// Lock-free ring for one producer and one consumer thread, capacity is rounded up to a power of 2
+template<typename T>
+class spsc_ring {
+public:
+    explicit spsc_ring(std::size_t capacity) : slots(round_up(capacity)), mask(slots.size() - 1) {}
+
+    spsc_ring(const spsc_ring&) = delete;
+    spsc_ring& operator=(const spsc_ring&) = delete;
+
+    // Slot to fill by the producer, nullptr when the ring is full
+    T* producer_slot() {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == slots.size()) return nullptr;
+        return &slots[t & mask];
+    }
+
+    // Publishes the slot returned by producer_slot
+    void push() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Oldest published slot, nullptr when the ring is empty
+    T* consumer_slot() {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return nullptr;
+        return &slots[h & mask];
+    }
+
+    // Releases the slot returned by consumer_slot to the producer
+    void pop() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    std::size_t capacity() const {
+        return slots.size();
+    }
+
+private:
+    static std::size_t round_up(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity) size <<= 1;
+        return size;
+    }
+
+    std::vector<T> slots;
+    std::size_t mask;
+    alignas(64) std::atomic<std::size_t> head{0}; //consumer index
+    alignas(64) std::atomic<std::size_t> tail{0}; //producer index
+};
+
+class prefetching_event_parser {
+public:
+    prefetching_event_parser(const std::string& path, std::size_t batches)
+    : parser(new event_text_parser(path)), ring(batches) {
+        producer = std::thread([this] { produce(); });
+    }
+
+    prefetching_event_parser(const prefetching_event_parser&) = delete;
+    prefetching_event_parser& operator=(const prefetching_event_parser&) = delete;
+
+    ~prefetching_event_parser() {
+        stop.store(true, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            not_full.notify_one();
+        }
+        producer.join();
+    }
+
+    // True while there are batches left, waits for the producer if needed
+    bool has_next() {
+        return wait_batch() != nullptr;
+    }
+
+    // Time of the next batch, only valid while has_next()
+    double next_time() {
+        return wait_batch()->time;
+    }
+
+    // Replaces the content of values with the next batch, only valid while has_next()
+    void take_batch(std::vector<std::int32_t>& values) {
+        values.clear();
+        std::swap(values, wait_batch()->values);
+        release_batch();
+    }
+
+    // Appends the next batch to values, only valid while has_next()
+    void append_batch(std::vector<std::int32_t>& values) {
+        const std::vector<std::int32_t>& batch = wait_batch()->values;
+        values.insert(values.end(), batch.begin(), batch.end());
+        release_batch();
+    }
+
+private:
+    std::unique_ptr<event_text_parser> parser; //only used by the producer thread
+    spsc_ring<event_batch> ring;
+    std::atomic<bool> done{false};
+    std::atomic<bool> stop{false};
+    std::exception_ptr error;
+    //a thread announces it is about to sleep before checking the ring a last time, and the other one
+    //checks the announcement after moving its index, both separated by fences, so a wake up is never lost
+    std::atomic<bool> producer_waiting{false};
+    std::atomic<bool> consumer_waiting{false};
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::thread producer;
+
+    void produce() {
+        try {
+            while (parser->has_next()) {
+                event_batch* batch = wait_slot();
+                if (batch == nullptr) return;
+                batch->values.clear();
+                batch->time = parser->read_batch(batch->values);
+                ring.push();
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (consumer_waiting.load(std::memory_order_relaxed)) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    not_empty.notify_one();
+                }
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        parser.reset();
+        std::lock_guard<std::mutex> lock(mutex);
+        done.store(true, std::memory_order_release);
+        not_empty.notify_one();
+    }
+
+    // Slot to fill, sleeping while the ring is full, nullptr when the parser is destroyed
+    event_batch* wait_slot() {
+        if (event_batch* batch = ring.producer_slot()) return batch;
+        std::unique_lock<std::mutex> lock(mutex);
+        producer_waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        event_batch* batch;
+        not_full.wait(lock, [&] { return (batch = ring.producer_slot()) != nullptr || stop.load(std::memory_order_relaxed); });
+        producer_waiting.store(false, std::memory_order_relaxed);
+        return (stop.load(std::memory_order_relaxed) ? nullptr : batch);
+    }
+
+    // Releases the oldest batch to the producer, waking it if it waits for a slot
+    void release_batch() {
+        ring.pop();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (producer_waiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            not_full.notify_one();
+        }
+    }
+
+    // Next published batch, sleeping while the ring is empty, nullptr when the list is over
+    event_batch* wait_batch() {
+        if (event_batch* batch = ring.consumer_slot()) return batch;
+        std::unique_lock<std::mutex> lock(mutex);
+        consumer_waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        event_batch* batch;
+        //the producer may publish its last batches before finishing, so the ring is checked first
+        not_empty.wait(lock, [&] { return (batch = ring.consumer_slot()) != nullptr || done.load(std::memory_order_acquire); });
+        consumer_waiting.store(false, std::memory_order_relaxed);
+        if (batch == nullptr && (batch = ring.consumer_slot()) == nullptr && error) std::rethrow_exception(error);
+        return batch;
+    }
+};
+
+#endif // EVENT_PREFETCHER_HPP
@@ -0,0 +1,249 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef EVENT_TEXT_PARSER_HPP
+#define EVENT_TEXT_PARSER_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Parser of text event lists: "time value" per line, sorted by time.
+ * Any whitespace separates the fields, as when the lists were read with operator>>.
+ *
+ * The file is read in large chunks and the numbers are parsed in place with std::from_chars.
+ * The parser looks one event ahead, so all the events sharing a timestamp are appended to a
+ * container in a single call to read_batch. Malformed or unsorted input throws a runtime_error
+ * telling the file and line of the problem. The order is not checked for parsers built with
+ * sorted=false, as the one reading the input of devstone-events sort.
+ */
+class event_text_parser {
+public:
+    static constexpr std::size_t default_chunk_bytes = 1 << 18;
+
+    explicit event_text_parser(const std::string& path, std::size_t chunk_bytes = default_chunk_bytes, bool sorted = true)
+    : path(path), is(path, std::ios_base::binary), check_order(sorted), buffer(std::max(chunk_bytes, 2 * max_token_bytes) + 1) {
+        if (!is.good()) throw std::runtime_error("failed to open events file: " + path);
+        advance();
+    }
+
+    event_text_parser(const event_text_parser&) = delete;
+    event_text_parser& operator=(const event_text_parser&) = delete;
+
+    // True while there are events left
+    bool has_next() const {
+        return pending;
+    }
+
+    // Time of the next event, only valid while has_next()
+    double next_time() const {
+        return pending_time;
+    }
+
+    // Value of the next event, only valid while has_next()
+    std::int32_t next_value() const {
+        return pending_value;
+    }
+
+    // Moves to the following event
+    void pop() {
+        advance();
+    }
+
+    // Appends the values of every event at next_time() to the container, returns their time
+    template<typename CONTAINER>
+    double read_batch(CONTAINER& values) {
+        double time = pending_time;
+        if (!pending) return time;
+        values.push_back(pending_value);
+        for (;;) {
+            //integer lines are parsed here into locals, the rest go through advance
+            const char* c = cursor;
+            std::uint64_t lines = 0;
+            double next_time = time;
+            std::int32_t value = 0;
+            while (end - c >= static_cast<std::ptrdiff_t>(max_token_bytes) && parse_integral(c, lines, next_time, value) && next_time == time) {
+                values.push_back(value);
+            }
+            line += lines;
+            cursor = c;
+            if (next_time != time) {
+                if (check_order && next_time < time) fail("events are not sorted by time", ", they can be sorted with devstone-events sort");
+                pending_time = next_time;
+                pending_value = value;
+                return time;
+            }
+            advance();
+            if (!pending || pending_time != time) return time;
+            values.push_back(pending_value);
+        }
+    }
+
+private:
+    static constexpr std::size_t max_token_bytes = 256;
+
+    std::string path;
+    std::ifstream is;
+    bool check_order;
+    std::vector<char> buffer;
+    const char* cursor = nullptr;
+    const char* end = nullptr;
+    bool eof = false;
+    std::uint64_t line = 1;
+
+    bool pending = false;
+    double pending_time = 0;
+    std::int32_t pending_value = 0;
+
+    [[noreturn]] void fail(const std::string& what, const std::string& hint = "") const {
+        throw std::runtime_error(what + " in " + path + " at line " + std::to_string(line) + hint);
+    }
+
+    // Keeps at least max_token_bytes after the cursor unless the file is over
+    void refill() {
+        std::size_t left = static_cast<std::size_t>(end - cursor);
+        if (eof || left >= max_token_bytes) return;
+        if (left > 0) std::memmove(buffer.data(), cursor, left);
+        is.read(buffer.data() + left, static_cast<std::streamsize>(buffer.size() - 1 - left));
+        std::size_t read = static_cast<std::size_t>(is.gcount());
+        if (read == 0 || is.eof()) eof = true;
+        cursor = buffer.data();
+        end = cursor + left + read;
+        buffer[left + read] = '\0'; //sentinel, neither a digit nor a separator
+    }
+
+    // Skips whitespace counting lines, returns false at the end of the file
+    bool skip_whitespace() {
+        for (;;) {
+            refill();
+            if (cursor == end) return false;
+            while (cursor != end) {
+                char c = *cursor;
+                if (c == '\n') {
+                    line++;
+                } else if (!is_separator(c)) {
+                    return true;
+                }
+                cursor++;
+            }
+        }
+    }
+
+    template<typename T>
+    T parse_field(const char* field) {
+        refill();
+        T value;
+        auto result = std::from_chars(cursor, end, value);
+        if (result.ec != std::errc() || (result.ptr != end && !is_separator(*result.ptr)) || (result.ptr == end && !eof)) {
+            malformed(field);
+        }
+        cursor = result.ptr;
+        return value;
+    }
+
+    [[noreturn]] void malformed(const char* field) const {
+        const char* token_end = cursor;
+        while (token_end != end && !is_separator(*token_end)) token_end++;
+        fail("malformed " + std::string(field) + " '" + std::string(cursor, token_end) + "'");
+    }
+
+    // space, \t, \n, \v, \f or \r
+    static bool is_separator(char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    // Parses the usual "integer integer" lines without from_chars, the rest take the general path.
+    // Returns false, leaving c as it was, when the line is not of that form. Loops stop at the
+    // sentinel after the end of the buffered data, the caller keeps max_token_bytes ahead of c.
+    bool parse_integral(const char*& c, std::uint64_t& lines, double& time, std::int32_t& value) const {
+        const char* p = c;
+        std::uint64_t newlines = 0;
+        while (is_separator(*p)) newlines += (*p++ == '\n');
+        const char* first = p;
+        std::uint64_t t = 0;
+        for (unsigned digit; (digit = static_cast<unsigned char>(*p) - '0') < 10; p++) t = t * 10 + digit;
+        if (p == first || p - first > 15 || (*p != ' ' && *p != '\t')) return false;
+        while (*p == ' ' || *p == '\t') p++;
+        bool negative = (*p == '-');
+        p += negative;
+        first = p;
+        std::uint64_t v = 0;
+        for (unsigned digit; (digit = static_cast<unsigned char>(*p) - '0') < 10; p++) v = v * 10 + digit;
+        if (p == first || p - first > 9 || p == end || !is_separator(*p)) return false;
+        c = p;
+        lines += newlines;
+        time = static_cast<double>(t);
+        value = static_cast<std::int32_t>(negative ? -static_cast<std::int64_t>(v) : static_cast<std::int64_t>(v));
+        return true;
+    }
+
+    // Moves to the following event when it is on an integer line
+    bool advance_integral() {
+        if (end - cursor < static_cast<std::ptrdiff_t>(max_token_bytes)) return false;
+        double time;
+        std::int32_t value;
+        std::uint64_t lines = 0;
+        const char* c = cursor;
+        if (!parse_integral(c, lines, time, value)) return false;
+        line += lines;
+        if (check_order && pending && time < pending_time) fail("events are not sorted by time", ", they can be sorted with devstone-events sort");
+        cursor = c;
+        pending = true;
+        pending_time = time;
+        pending_value = value;
+        return true;
+    }
+
+    void advance() {
+        refill();
+        if (advance_integral()) return;
+        if (!skip_whitespace()) {
+            pending = false;
+            return;
+        }
+        if (*cursor == '+') cursor++; //operator>> accepted an explicit sign, from_chars does not
+        double time = parse_field<double>("event time");
+        std::uint64_t time_line = line;
+        if (!skip_whitespace()) {
+            line = time_line;
+            fail("event without value");
+        }
+        if (*cursor == '+') cursor++;
+        std::int32_t value = parse_field<std::int32_t>("event value");
+        if (check_order && pending && time < pending_time) fail("events are not sorted by time", ", they can be sorted with devstone-events sort");
+        pending = true;
+        pending_time = time;
+        pending_value = value;
+    }
+};
+
+#endif // EVENT_TEXT_PARSER_HPP
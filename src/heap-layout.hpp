@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HEAP_LAYOUT_HPP
+#define HEAP_LAYOUT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "topology.hpp"
+
+/**
+ * Placement of the atomics of a DEVStone in memory.
+ *
+ * - system: every atomic is allocated by the system allocator, interleaved with the rest of the models.
+ * - depth-first: atomics are contiguous in an arena, in the order the simulators visit them, which is
+ *   level 0 first and then every level up to the last one.
+ * - breadth-first: atomics are contiguous in an arena, the atomics of the last level first.
+ * - scattered: atomics are in an arena in a random order, with random padding of up to 15 cache lines
+ *   between them.
+ *
+ * Atomics have to be allocated in the order of the topology, as the topology adapters construct them.
+ */
+
+enum heap_layout {system_heap, depth_first_heap, breadth_first_heap, scattered_heap};
+
+std::istream& operator>>(std::istream& in, heap_layout& layout) {
+    std::string input;
+    in >> input;
+    if (input == "system") {
+        layout = system_heap;
+    } else if (input == "depth-first") {
+        layout = depth_first_heap;
+    } else if (input == "breadth-first") {
+        layout = breadth_first_heap;
+    } else if (input == "scattered") {
+        layout = scattered_heap;
+    } else {
+        in.setstate(std::ios_base::failbit);
+    }
+    return in;
+}
+
+std::ostream& operator<<(std::ostream& os, const heap_layout& layout) {
+    switch (layout) {
+        case system_heap: return os << "system";
+        case depth_first_heap: return os << "depth-first";
+        case breadth_first_heap: return os << "breadth-first";
+        case scattered_heap: return os << "scattered";
+    }
+    return os;
+}
+
+// Arena holding the atomics of a topology, each allocation is the next atomic of the topology.
+// The memory is released with the arena, atomics keep it alive through their allocators.
+class atomic_heap {
+    static constexpr std::size_t cache_line = 64;
+
+    heap_layout _layout;
+    std::vector<std::size_t> _slots; //slot of each atomic, in the order of the topology
+    std::uint64_t _seed;
+    std::vector<std::size_t> _offsets; //offset of each slot, known once the size of the atomics is
+    char* _arena = nullptr;
+    std::size_t _arena_bytes = 0;
+    std::size_t _allocation_bytes = 0;
+    std::size_t _allocated = 0;
+
+    void reserve_arena(std::size_t bytes, std::size_t alignment) {
+        _allocation_bytes = bytes;
+        std::size_t stride = (bytes + alignment - 1) / alignment * alignment;
+        std::mt19937_64 rng(_seed + 1);
+        std::uniform_int_distribution<std::size_t> padding(0, 15);
+        _offsets.resize(_slots.size());
+        for (std::size_t slot = 0; slot < _offsets.size(); slot++) {
+            if (_layout == scattered_heap) {
+                _arena_bytes += padding(rng) * cache_line;
+            }
+            _offsets[slot] = _arena_bytes;
+            _arena_bytes += stride;
+        }
+        _arena = static_cast<char*>(::operator new(std::max<std::size_t>(_arena_bytes, 1), std::align_val_t(cache_line)));
+    }
+
+public:
+    atomic_heap(heap_layout layout, const topology_view& topology, std::uint64_t seed=1)
+        : _layout(layout), _slots(topology.atomics.size()), _seed(seed) {
+        if (layout == system_heap) throw std::runtime_error("the system layout does not use an arena");
+        std::iota(_slots.begin(), _slots.end(), 0);
+        if (layout == breadth_first_heap) {
+            //atomics are sorted by level, the levels are reversed keeping the order inside each level
+            std::vector<std::size_t> level_atomics(topology.depth + 1, 0);
+            for (const topology_atomic& atomic : topology.atomics) level_atomics[atomic.level]++;
+            std::vector<std::size_t> level_first(topology.depth + 1, 0);
+            for (std::size_t level = topology.depth; level-- > 0;) {
+                level_first[level] = level_first[level + 1] + level_atomics[level + 1];
+            }
+            for (std::size_t i = 0; i < _slots.size(); i++) {
+                _slots[i] = level_first[topology.atomics[i].level]++;
+            }
+        } else if (layout == scattered_heap) {
+            std::shuffle(_slots.begin(), _slots.end(), std::mt19937_64(seed));
+        }
+    }
+
+    atomic_heap(const atomic_heap&) = delete;
+    atomic_heap& operator=(const atomic_heap&) = delete;
+
+    ~atomic_heap() {
+        if (_arena) ::operator delete(_arena, std::align_val_t(cache_line));
+    }
+
+    void* allocate(std::size_t bytes, std::size_t alignment) {
+        alignment = std::max(alignment, alignof(std::max_align_t));
+        if (alignment > cache_line) throw std::bad_alloc();
+        if (!_arena) reserve_arena(bytes, alignment);
+        if (bytes != _allocation_bytes) throw std::runtime_error("every atomic of the heap must have the same size");
+        if (_allocated == _slots.size()) throw std::runtime_error("more atomics allocated than those of the topology");
+        return _arena + _offsets[_slots[_allocated++]];
+    }
+
+    heap_layout layout() const { return _layout; }
+    std::size_t arena_bytes() const { return _arena_bytes; }
+    std::size_t allocated() const { return _allocated; }
+};
+
+// Allocator of models in an atomic_heap, memory is never freed before the heap
+template<typename T>
+class atomic_heap_allocator {
+public:
+    using value_type = T;
+
+    explicit atomic_heap_allocator(std::shared_ptr<atomic_heap> heap) : _heap(std::move(heap)) {}
+
+    template<typename U>
+    atomic_heap_allocator(const atomic_heap_allocator<U>& other) : _heap(other.heap()) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(_heap->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, std::size_t) {}
+
+    const std::shared_ptr<atomic_heap>& heap() const { return _heap; }
+
+private:
+    std::shared_ptr<atomic_heap> _heap;
+};
+
+template<typename T, typename U>
+bool operator==(const atomic_heap_allocator<T>& a, const atomic_heap_allocator<U>& b) {
+    return a.heap() == b.heap();
+}
+
+template<typename T, typename U>
+bool operator!=(const atomic_heap_allocator<T>& a, const atomic_heap_allocator<U>& b) {
+    return !(a == b);
+}
+
+// Creates the next atomic of the heap, the system allocator is used without a heap
+template<typename T, typename... Args>
+std::shared_ptr<T> make_atomic_in(const std::shared_ptr<atomic_heap>& heap, Args&&... args) {
+    if (!heap) return std::make_shared<T>(std::forward<Args>(args)...);
+    return std::allocate_shared<T>(atomic_heap_allocator<T>(heap), std::forward<Args>(args)...);
+}
+
+#endif // HEAP_LAYOUT_HPP
@@ -26,6 +26,13 @@
 #ifndef HELPERS_HPP
 #define HELPERS_HPP
 
+#include <fstream>
+#include <istream>
+#include <string>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
 
 enum devstone_kind {LI, HI, HO, HOmod};
 
@@ -46,6 +53,29 @@ std::istream& operator>>(std::istream& in, devstone_kind& kind) {
     return in;
 }
 
+// Amount of atomic models of a DEVStone, the level 0 atomic included
+unsigned long devstone_atomics(devstone_kind kind, unsigned long width, unsigned long depth) {
+    if (width < 1 || depth < 1) return 0;
+    unsigned long per_level = (kind == HOmod ? (width - 1) * (width + 2) / 2 : width - 1);
+    return per_level * (depth - 1) + 1;
+}
+
+// Peak resident set size of the process so far, in kilobytes
+long peak_rss_kb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;
+}
+
+// Resident set size of the process now, in kilobytes. Unlike the peak, it is not hidden by earlier spikes
+long current_rss_kb() {
+    std::ifstream statm("/proc/self/statm");
+    long pages = 0;
+    long resident_pages = 0;
+    if (!(statm >> pages >> resident_pages)) return 0;
+    return resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
 
 
 
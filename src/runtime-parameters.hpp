@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RUNTIME_PARAMETERS_HPP
+#define RUNTIME_PARAMETERS_HPP
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "workload-kernels.hpp"
+
+/**
+ * Workload parameters of generated static models that are read from the command line of the model,
+ * instead of being compiled in, so a single compilation of a topology runs any transition costs.
+ *
+ * The generated model passes the parameters given when it was generated as defaults, and the atomics and the
+ * event reader take them from runtime_parameters() when the runner constructs them.
+ * Costs are given in cycles, nanosecond budgets are only translated by the generator.
+ */
+
+struct generated_model_parameters {
+    int period;
+    int external_cycles;
+    int internal_cycles;
+    workload work;
+    std::string event_list;
+};
+
+generated_model_parameters& runtime_parameters() {
+    static generated_model_parameters parameters;
+    return parameters;
+}
+
+// Reads the value of an option into a field, returns false if it can not be parsed
+template<typename T>
+bool read_runtime_parameter(const std::string& value, T& field) {
+    std::istringstream is(value);
+    T parsed;
+    if (!(is >> parsed) || !is.eof()) return false;
+    field = parsed;
+    return true;
+}
+
+bool read_runtime_parameter(const std::string& value, std::string& field) {
+    field = value;
+    return true;
+}
+
+// Sets the runtime parameters from --time-advance, --ext-cycles, --int-cycles, --kernel, --kernel-buffer-kb and
+// --event-list, as --option=value or --option value, the options of the allocation layer are skipped.
+// Prints the error and returns false if an option is unknown or its value is not valid, cycles and the time
+// advance can not be negative, as in the generator.
+bool parse_runtime_parameters(int argc, char* argv[], const generated_model_parameters& defaults, std::ostream& err=std::cerr) {
+    generated_model_parameters& parameters = runtime_parameters();
+    parameters = defaults;
+    int kernel_buffer_kb = static_cast<int>(defaults.work.buffer_bytes / 1024);
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--huge-pages" || argument == "--allocation-stats") continue;
+        std::string name = argument;
+        std::string value;
+        std::size_t equals = argument.find('=');
+        if (equals != std::string::npos) {
+            name = argument.substr(0, equals);
+            value = argument.substr(equals + 1);
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        } else {
+            err << "The option " << argument << " needs a value" << std::endl;
+            return false;
+        }
+
+        bool valid;
+        if (name == "--time-advance") valid = read_runtime_parameter(value, parameters.period) && parameters.period >= 0;
+        else if (name == "--ext-cycles") valid = read_runtime_parameter(value, parameters.external_cycles) && parameters.external_cycles >= 0;
+        else if (name == "--int-cycles") valid = read_runtime_parameter(value, parameters.internal_cycles) && parameters.internal_cycles >= 0;
+        else if (name == "--kernel") valid = read_runtime_parameter(value, parameters.work.kernel);
+        else if (name == "--kernel-buffer-kb") valid = read_runtime_parameter(value, kernel_buffer_kb) && kernel_buffer_kb > 0;
+        else if (name == "--event-list") valid = read_runtime_parameter(value, parameters.event_list);
+        else if (name == "--allocator") valid = true;
+        else {
+            err << "Unknown option " << name << ", the options are --time-advance, --ext-cycles, --int-cycles, --kernel, --kernel-buffer-kb and --event-list" << std::endl;
+            return false;
+        }
+        if (!valid) {
+            err << "The value " << value << " is not valid for " << name << std::endl;
+            return false;
+        }
+    }
+    parameters.work.buffer_bytes = static_cast<std::size_t>(kernel_buffer_kb) * 1024;
+    return true;
+}
+
+#endif // RUNTIME_PARAMETERS_HPP
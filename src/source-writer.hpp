@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOURCE_WRITER_HPP
+#define SOURCE_WRITER_HPP
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Buffered writer of generated sources. Text and integers are copied to a buffer that is written to the
+// file when full, so the cost of emitting a source is linear in its size and there is a single system call
+// per buffer. Throws if the file can not be opened or written.
+class source_writer {
+    std::FILE* _file;
+    std::string _path;
+    std::vector<char> _buffer;
+    std::size_t _used = 0;
+    std::uint64_t _bytes = 0;
+
+    void write_buffer(const char* data, std::size_t size) {
+        if (size > 0 && std::fwrite(data, 1, size, _file) != size) {
+            throw std::runtime_error("failed to write generated source: " + _path);
+        }
+    }
+
+public:
+    explicit source_writer(const std::string& path, std::size_t buffer_bytes=1 << 20)
+        : _file(std::fopen(path.c_str(), "wb")), _path(path), _buffer(buffer_bytes) {
+        if (!_file) throw std::runtime_error("failed to open generated source: " + path);
+    }
+
+    source_writer(const source_writer&) = delete;
+    source_writer& operator=(const source_writer&) = delete;
+
+    ~source_writer() {
+        if (_file) {
+            std::fwrite(_buffer.data(), 1, _used, _file);
+            std::fclose(_file);
+        }
+    }
+
+    void write(const char* data, std::size_t size) {
+        _bytes += size;
+        if (size > _buffer.size() - _used) {
+            flush();
+            if (size >= _buffer.size()) {
+                write_buffer(data, size);
+                return;
+            }
+        }
+        std::memcpy(_buffer.data() + _used, data, size);
+        _used += size;
+    }
+
+    source_writer& operator<<(std::string_view text) {
+        write(text.data(), text.size());
+        return *this;
+    }
+
+    source_writer& operator<<(const char* text) {
+        write(text, std::strlen(text));
+        return *this;
+    }
+
+    source_writer& operator<<(const std::string& text) {
+        write(text.data(), text.size());
+        return *this;
+    }
+
+    source_writer& operator<<(char c) {
+        write(&c, 1);
+        return *this;
+    }
+
+    template<typename INTEGER, typename = std::enable_if_t<std::is_integral<INTEGER>::value && !std::is_same<INTEGER, char>::value && !std::is_same<INTEGER, bool>::value>>
+    source_writer& operator<<(INTEGER value) {
+        char digits[24];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+        write(digits, static_cast<std::size_t>(result.ptr - digits));
+        return *this;
+    }
+
+    void flush() {
+        write_buffer(_buffer.data(), _used);
+        _used = 0;
+    }
+
+    // Writes what is left in the buffer and closes the file
+    void close() {
+        flush();
+        int closed = std::fclose(_file);
+        _file = nullptr;
+        if (closed != 0) throw std::runtime_error("failed to write generated source: " + _path);
+    }
+
+    // Bytes emitted so far, buffered or not
+    std::uint64_t bytes() const { return _bytes; }
+};
+
+#endif // SOURCE_WRITER_HPP
@@ -0,0 +1,310 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TOPOLOGY_BINARY_HPP
+#define TOPOLOGY_BINARY_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "topology.hpp"
+
+/**
+ * Topology snapshots: a fixed size header followed by the arrays of a devstone_topology, in the order
+ * atomics, coupleds, submodels and couplings. Records are stored as they are in memory, so loading a
+ * snapshot maps the file and reads the arrays in place, without parsing nor copying them, once the records
+ * are checked in a single pass. Fields are stored in the byte order of the host and padding bytes inside the
+ * records are zero.
+ *
+ * They are produced with: cadmium-dynamic-devstone --save-topology=<file>
+ */
+
+const char topology_snapshot_magic[8] = {'D', 'E', 'V', 'S', 'T', 'O', 'P', 'O'};
+const std::uint32_t topology_snapshot_version = 1;
+
+struct topology_snapshot_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t kind;
+    std::uint32_t width;
+    std::uint32_t depth;
+    std::uint32_t atomic_size;
+    std::uint32_t coupled_size;
+    std::uint32_t submodel_size;
+    std::uint32_t coupling_size;
+    std::uint64_t atomics;
+    std::uint64_t coupleds;
+    std::uint64_t submodels;
+    std::uint64_t couplings;
+};
+
+//every array starts aligned, since the header and all the records keep the alignment of the records
+static_assert(sizeof(topology_snapshot_header) % alignof(topology_atomic) == 0
+              && sizeof(topology_atomic) % alignof(topology_coupled) == 0
+              && sizeof(topology_coupled) % alignof(topology_model) == 0
+              && sizeof(topology_model) % alignof(topology_coupling) == 0,
+              "records must be aligned after the previous array");
+
+// Records are written field by field over zeroed memory, so their padding is always zero and the same
+// topology always gives the same file
+template<typename FIELD>
+void store_topology_field(char* slot, std::size_t offset, const FIELD& field) {
+    std::memcpy(slot + offset, &field, sizeof(FIELD));
+}
+
+void store_topology_record(char* slot, const topology_atomic& atomic) {
+    store_topology_field(slot, offsetof(topology_atomic, level), atomic.level);
+    store_topology_field(slot, offsetof(topology_atomic, column), atomic.column);
+    store_topology_field(slot, offsetof(topology_atomic, row), atomic.row);
+}
+
+void store_topology_record(char* slot, const topology_coupled& coupled) {
+    store_topology_field(slot, offsetof(topology_coupled, level), coupled.level);
+    store_topology_field(slot, offsetof(topology_coupled, first_submodel), coupled.first_submodel);
+    store_topology_field(slot, offsetof(topology_coupled, submodels), coupled.submodels);
+    store_topology_field(slot, offsetof(topology_coupled, first_coupling), coupled.first_coupling);
+    store_topology_field(slot, offsetof(topology_coupled, couplings), coupled.couplings);
+}
+
+void store_topology_record(char* slot, const topology_model& model) {
+    store_topology_field(slot, offsetof(topology_model, index), model.index);
+    store_topology_field(slot, offsetof(topology_model, is_coupled), model.is_coupled);
+}
+
+void store_topology_record(char* slot, const topology_coupling& coupling) {
+    store_topology_field(slot, offsetof(topology_coupling, kind), coupling.kind);
+    store_topology_field(slot, offsetof(topology_coupling, from_port), coupling.from_port);
+    store_topology_field(slot, offsetof(topology_coupling, to_port), coupling.to_port);
+    store_topology_record(slot + offsetof(topology_coupling, from), coupling.from);
+    store_topology_record(slot + offsetof(topology_coupling, to), coupling.to);
+}
+
+template<typename RECORD>
+void write_topology_records(std::ostream& os, const topology_array<RECORD>& records) {
+    const std::size_t block_records = 4096;
+    std::vector<char> block(std::min(records.size(), block_records) * sizeof(RECORD));
+    for (std::size_t first = 0; first < records.size(); first += block_records) {
+        std::size_t count = std::min(records.size() - first, block_records);
+        std::fill(block.begin(), block.begin() + count * sizeof(RECORD), 0);
+        for (std::size_t i = 0; i < count; i++) {
+            store_topology_record(block.data() + i * sizeof(RECORD), records[first + i]);
+        }
+        os.write(block.data(), count * sizeof(RECORD));
+    }
+}
+
+// Writes the snapshot of a topology to a file, throws if it could not be written
+void save_devstone_topology(const topology_view& topology, const std::string& path) {
+    topology_snapshot_header header{};
+    std::memcpy(header.magic, topology_snapshot_magic, sizeof(topology_snapshot_magic));
+    header.version = topology_snapshot_version;
+    header.kind = topology.kind;
+    header.width = topology.width;
+    header.depth = topology.depth;
+    header.atomic_size = sizeof(topology_atomic);
+    header.coupled_size = sizeof(topology_coupled);
+    header.submodel_size = sizeof(topology_model);
+    header.coupling_size = sizeof(topology_coupling);
+    header.atomics = topology.atomics.size();
+    header.coupleds = topology.coupleds.size();
+    header.submodels = topology.submodels.size();
+    header.couplings = topology.couplings.size();
+
+    std::ofstream os(path, std::ios_base::binary | std::ios_base::trunc);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_topology_records(os, topology.atomics);
+    write_topology_records(os, topology.coupleds);
+    write_topology_records(os, topology.submodels);
+    write_topology_records(os, topology.couplings);
+    os.close();
+    if (!os) throw std::runtime_error("failed to write topology file: " + path);
+}
+
+// Takes the next array of a mapped snapshot in place, returns false if the file is too short to hold it
+template<typename RECORD>
+bool map_topology_records(const char*& data, const char* end, std::uint64_t size, topology_array<RECORD>& records) {
+    if (size > static_cast<std::uint64_t>(end - data) / sizeof(RECORD)) return false;
+    records = topology_array<RECORD>(reinterpret_cast<const RECORD*>(data), size);
+    data += size * sizeof(RECORD);
+    return true;
+}
+
+// Checks that the records only refer to models, submodels and couplings inside the arrays, and to the models
+// already translated when their coupled model is, and that their enums and ports are valid for the kind.
+// Snapshots with the sizes expected but corrupt records are rejected instead of read out of bounds.
+bool topology_records_are_valid(const topology_view& topology) {
+    unsigned int inputs = coupled_input_ports(topology.kind);
+    unsigned int outputs = coupled_output_ports(topology.kind);
+    auto is_coupled = [](const topology_model& model) {
+        std::uint8_t raw; //a bool copied from a file may hold any byte
+        std::memcpy(&raw, &model.is_coupled, sizeof(raw));
+        return raw;
+    };
+    auto input_port_of = [&](const topology_model& model, topology_port port) {
+        if (is_coupled(model)) return port == coupled_in1 || (port == coupled_in2 && inputs > 1);
+        return port == atomic_in;
+    };
+    auto output_port_of = [&](const topology_model& model, topology_port port) {
+        if (is_coupled(model)) return port == coupled_out1 || (port == coupled_out2 && outputs > 1);
+        return port == atomic_out;
+    };
+
+    for (std::size_t a = 0; a < topology.atomics.size(); a++) {
+        const topology_atomic& atomic = topology.atomics[a];
+        if (atomic.level >= topology.depth || (a > 0 && atomic.level < topology.atomics[a - 1].level)) return false;
+    }
+
+    //the atomics of a level are translated with the coupled model of the next one
+    std::size_t atomics_translated = 0;
+    for (std::size_t c = 0; c < topology.coupleds.size(); c++) {
+        const topology_coupled& coupled = topology.coupleds[c];
+        if (coupled.level != c + 1
+            || std::uint64_t(coupled.first_submodel) + coupled.submodels > topology.submodels.size()
+            || std::uint64_t(coupled.first_coupling) + coupled.couplings > topology.couplings.size()) return false;
+        while (atomics_translated < topology.atomics.size() && topology.atomics[atomics_translated].level < coupled.level) {
+            atomics_translated++;
+        }
+        //submodels are coupled models of previous levels, couplings may also refer to the coupled model itself
+        auto valid_model = [&](const topology_model& model, std::size_t coupleds_translated) {
+            std::uint8_t raw = is_coupled(model);
+            if (raw > 1) return false;
+            return model.index < (raw ? coupleds_translated : atomics_translated);
+        };
+        for (std::uint32_t s = coupled.first_submodel; s < coupled.first_submodel + coupled.submodels; s++) {
+            if (!valid_model(topology.submodels[s], c)) return false;
+        }
+        for (std::uint32_t i = coupled.first_coupling; i < coupled.first_coupling + coupled.couplings; i++) {
+            const topology_coupling& coupling = topology.couplings[i];
+            if (!valid_model(coupling.from, c + 1) || !valid_model(coupling.to, c + 1)) return false;
+            bool ports_valid = false;
+            switch (coupling.kind) {
+                case topology_eic:
+                    ports_valid = input_port_of(topology_model{0, true}, coupling.from_port) && input_port_of(coupling.to, coupling.to_port);
+                    break;
+                case topology_eoc:
+                    ports_valid = output_port_of(coupling.from, coupling.from_port) && output_port_of(topology_model{0, true}, coupling.to_port);
+                    break;
+                case topology_ic:
+                    ports_valid = output_port_of(coupling.from, coupling.from_port) && input_port_of(coupling.to, coupling.to_port);
+                    break;
+            }
+            if (!ports_valid) return false;
+        }
+    }
+    return true;
+}
+
+// Snapshot written by save_devstone_topology mapped in memory, the topology is read from the mapped records
+// without copying them and stays valid while the snapshot is. Throws if the file is not a valid snapshot.
+class mapped_devstone_topology {
+public:
+    explicit mapped_devstone_topology(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("failed to open topology file: " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(topology_snapshot_header)) {
+            close(fd);
+            throw std::runtime_error("not a topology snapshot: " + path);
+        }
+        _size = static_cast<std::size_t>(st.st_size);
+        _mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (_mapped == MAP_FAILED) throw std::runtime_error("failed to map topology file: " + path);
+        madvise(_mapped, _size, MADV_SEQUENTIAL);
+
+        const topology_snapshot_header* header = static_cast<const topology_snapshot_header*>(_mapped);
+        const char* data = static_cast<const char*>(_mapped) + sizeof(topology_snapshot_header);
+        const char* end = static_cast<const char*>(_mapped) + _size;
+        bool valid = std::memcmp(header->magic, topology_snapshot_magic, sizeof(topology_snapshot_magic)) == 0
+                     && header->version == topology_snapshot_version
+                     && header->kind <= HOmod
+                     && header->atomic_size == sizeof(topology_atomic)
+                     && header->coupled_size == sizeof(topology_coupled)
+                     && header->submodel_size == sizeof(topology_model)
+                     && header->coupling_size == sizeof(topology_coupling);
+        if (valid) {
+            _view.kind = static_cast<devstone_kind>(header->kind);
+            _view.width = header->width;
+            _view.depth = header->depth;
+            valid = map_topology_records(data, end, header->atomics, _view.atomics)
+                    && map_topology_records(data, end, header->coupleds, _view.coupleds)
+                    && map_topology_records(data, end, header->submodels, _view.submodels)
+                    && map_topology_records(data, end, header->couplings, _view.couplings);
+        }
+
+        //the arrays are not parsed, they are checked in place once mapped
+        valid = valid
+                && _view.atomics.size() == devstone_atomics(_view.kind, _view.width, _view.depth)
+                && _view.couplings.size() == devstone_couplings(_view.kind, _view.width, _view.depth)
+                && _view.coupleds.size() == (_view.width > 0 ? _view.depth : 0)
+                && topology_records_are_valid(_view);
+        if (!valid) {
+            munmap(_mapped, _size);
+            throw std::runtime_error("not a topology snapshot, or truncated: " + path);
+        }
+    }
+
+    mapped_devstone_topology(const mapped_devstone_topology&) = delete;
+    mapped_devstone_topology& operator=(const mapped_devstone_topology&) = delete;
+
+    ~mapped_devstone_topology() {
+        munmap(_mapped, _size);
+    }
+
+    const topology_view& view() const { return _view; }
+
+private:
+    void* _mapped = nullptr;
+    std::size_t _size = 0;
+    topology_view _view{LI, 0, 0, {}, {}, {}, {}};
+};
+
+// Loads a copy of the topology of a snapshot, throws if it is not a valid snapshot
+devstone_topology load_devstone_topology(const std::string& path) {
+    mapped_devstone_topology mapped(path);
+    const topology_view& view = mapped.view();
+    devstone_topology topology;
+    topology.kind = view.kind;
+    topology.width = view.width;
+    topology.depth = view.depth;
+    topology.atomics.assign(view.atomics.begin(), view.atomics.end());
+    topology.coupleds.assign(view.coupleds.begin(), view.coupleds.end());
+    topology.submodels.assign(view.submodels.begin(), view.submodels.end());
+    topology.couplings.assign(view.couplings.begin(), view.couplings.end());
+    return topology;
+}
+
+#endif // TOPOLOGY_BINARY_HPP
@@ -0,0 +1,343 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TOPOLOGY_HPP
+#define TOPOLOGY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "helpers.hpp"
+
+// Intermediate representation of a DEVStone topology.
+// It is built once in flat arrays where models refer to each other by index, and thin adapters translate
+// it to the models of every simulator, so all of them simulate exactly the same graph.
+
+// Ports of the models, atomics have one input and one output, coupled models up to two of each
+enum topology_port : std::uint8_t {atomic_in, atomic_out, coupled_in1, coupled_in2, coupled_out1, coupled_out2};
+
+// An atomic or a coupled model of the topology, by its index in the array of its type
+struct topology_model {
+    std::uint32_t index;
+    bool is_coupled;
+};
+
+// Atomics are placed in their level by column, HOmod atomics also by row
+struct topology_atomic {
+    static constexpr std::uint32_t no_row = UINT32_MAX;
+    std::uint32_t level;
+    std::uint32_t column;
+    std::uint32_t row;
+};
+
+enum topology_coupling_kind : std::uint8_t {topology_eic, topology_eoc, topology_ic};
+
+// EICs go from an input port of the coupled model to a submodel, EOCs from a submodel to an output port of the
+// coupled model and ICs between submodels. The model on the coupled model side of EICs and EOCs is not used.
+struct topology_coupling {
+    topology_coupling_kind kind;
+    topology_port from_port;
+    topology_port to_port;
+    topology_model from;
+    topology_model to;
+};
+
+// The submodels and the couplings of a coupled model are ranges of the arrays of the topology
+struct topology_coupled {
+    std::uint32_t level;
+    std::uint32_t first_submodel;
+    std::uint32_t submodels;
+    std::uint32_t first_coupling;
+    std::uint32_t couplings;
+};
+
+struct devstone_topology {
+    devstone_kind kind;
+    unsigned int width;
+    unsigned int depth;
+    std::vector<topology_atomic> atomics; //by level, atomics[0] is the only atomic of level 0
+    std::vector<topology_coupled> coupleds; //coupleds[l - 1] is the coupled of level l, the last one is the root
+    std::vector<topology_model> submodels;
+    std::vector<topology_coupling> couplings;
+};
+
+// Read only range of records, either of a devstone_topology or of a snapshot mapped in memory
+template<typename RECORD>
+class topology_array {
+public:
+    topology_array() = default;
+    topology_array(const RECORD* data, std::size_t size) : _data(data), _size(size) {}
+    topology_array(const std::vector<RECORD>& records) : _data(records.data()), _size(records.size()) {}
+
+    const RECORD& operator[](std::size_t i) const { return _data[i]; }
+    const RECORD* begin() const { return _data; }
+    const RECORD* end() const { return _data + _size; }
+    std::size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+private:
+    const RECORD* _data = nullptr;
+    std::size_t _size = 0;
+};
+
+// Topology read by the adapters, it does not own the records, which outlive it
+struct topology_view {
+    devstone_kind kind;
+    unsigned int width;
+    unsigned int depth;
+    topology_array<topology_atomic> atomics;
+    topology_array<topology_coupled> coupleds;
+    topology_array<topology_model> submodels;
+    topology_array<topology_coupling> couplings;
+
+    topology_view(devstone_kind kind, unsigned int width, unsigned int depth,
+                  topology_array<topology_atomic> atomics, topology_array<topology_coupled> coupleds,
+                  topology_array<topology_model> submodels, topology_array<topology_coupling> couplings)
+        : kind(kind), width(width), depth(depth), atomics(atomics), coupleds(coupleds), submodels(submodels), couplings(couplings) {}
+
+    topology_view(const devstone_topology& topology)
+        : topology_view(topology.kind, topology.width, topology.depth, topology.atomics, topology.coupleds, topology.submodels, topology.couplings) {}
+};
+
+// Input and output ports of the coupled models of each kind
+unsigned int coupled_input_ports(devstone_kind kind) {
+    return (kind == HO || kind == HOmod ? 2 : 1);
+}
+
+unsigned int coupled_output_ports(devstone_kind kind) {
+    return (kind == HO ? 2 : 1);
+}
+
+// Amount of couplings of a DEVStone, those of the TOP model excluded
+unsigned long devstone_couplings(devstone_kind kind, unsigned long width, unsigned long depth) {
+    if (width < 1 || depth < 1) return 0;
+    unsigned long columns = width - 1;
+    unsigned long atomics = (kind == HOmod ? columns * (width + 2) / 2 : columns);
+    unsigned long chained = (atomics > 0 ? atomics - 1 : 0);
+    unsigned long per_level = 0;
+    switch (kind) {
+        case LI: per_level = 2 + atomics; break;
+        case HI: per_level = 2 + atomics + chained; break;
+        case HO: per_level = 3 + 2 * atomics + chained; break;
+        case HOmod: per_level = 2 + 2 * columns + atomics; break;
+    }
+    return 2 + per_level * (depth - 1);
+}
+
+// Builds the topology of a DEVStone in the order used by the dynamic Cadmium generators:
+// the coupled model of the previous level is the first submodel of each level, followed by its atomics
+devstone_topology make_devstone_topology(devstone_kind kind, unsigned int width, unsigned int depth) {
+    devstone_topology topology;
+    topology.kind = kind;
+    topology.width = width;
+    topology.depth = depth;
+    if (width < 1 || depth < 1) return topology;
+
+    std::uint32_t columns = width - 1;
+    std::uint32_t atomics_per_level = devstone_atomics(kind, width, 2) - 1;
+    topology.atomics.reserve(devstone_atomics(kind, width, depth));
+    topology.coupleds.reserve(depth);
+    topology.submodels.reserve(topology.atomics.capacity() + depth - 1);
+    topology.couplings.reserve(devstone_couplings(kind, width, depth));
+
+    auto add_eic = [&topology](topology_port from_port, topology_model to, topology_port to_port) {
+        topology.couplings.push_back({topology_eic, from_port, to_port, topology_model{0, true}, to});
+    };
+    auto add_eoc = [&topology](topology_model from, topology_port from_port, topology_port to_port) {
+        topology.couplings.push_back({topology_eoc, from_port, to_port, from, topology_model{0, true}});
+    };
+    auto add_ic = [&topology](topology_model from, topology_port from_port, topology_model to, topology_port to_port) {
+        topology.couplings.push_back({topology_ic, from_port, to_port, from, to});
+    };
+
+    //Level 0 has always a single model
+    topology.atomics.push_back({0, 0, topology_atomic::no_row});
+
+    for (std::uint32_t level = 1; level <= depth; level++) {
+        topology_coupled coupled{level, std::uint32_t(topology.submodels.size()), 0, std::uint32_t(topology.couplings.size()), 0};
+
+        if (level == 1) {
+            topology_model atomic{0, false};
+            topology.submodels.push_back(atomic);
+            add_eic(coupled_in1, atomic, atomic_in);
+            add_eoc(atomic, atomic_out, coupled_out1);
+        } else {
+            topology_model coupled_prev_level{level - 2, true};
+            std::uint32_t first_atomic = 1 + (level - 2) * atomics_per_level;
+            topology.submodels.push_back(coupled_prev_level);
+            add_eic(coupled_in1, coupled_prev_level, coupled_in1);
+            if (kind == HO) {
+                add_eic(coupled_in1, coupled_prev_level, coupled_in2);
+            }
+            add_eoc(coupled_prev_level, coupled_out1, coupled_out1);
+
+            if (kind == HOmod) {
+                std::uint32_t index = first_atomic;
+                for (std::uint32_t column = 0; column < columns; column++) {
+                    for (std::uint32_t row = 0; row < column + 2; row++, index++) {
+                        topology_model atomic{index, false};
+                        if (row == 0 || row == column + 1) { //only first and last row
+                            add_eic(coupled_in2, atomic, atomic_in);
+                        }
+                        if (row == 0) {
+                            add_ic(atomic, atomic_out, coupled_prev_level, coupled_in2);
+                        } else {
+                            add_ic(atomic, atomic_out, topology_model{index - 1, false}, atomic_in);
+                        }
+                        topology.submodels.push_back(atomic);
+                    }
+                }
+            } else {
+                for (std::uint32_t i = 0; i < atomics_per_level; i++) {
+                    topology_model atomic{first_atomic + i, false};
+                    add_eic(kind == HO ? coupled_in2 : coupled_in1, atomic, atomic_in);
+                    if (kind == HO) {
+                        add_eoc(atomic, atomic_out, coupled_out2);
+                    }
+                    if ((kind == HI || kind == HO) && i + 1 < atomics_per_level) {
+                        add_ic(atomic, atomic_out, topology_model{first_atomic + i + 1, false}, atomic_in);
+                    }
+                    topology.submodels.push_back(atomic);
+                }
+            }
+        }
+
+        //atomics of this level are submodels of the next one, last level does not have atomics
+        if (level < depth) {
+            if (kind == HOmod) {
+                for (std::uint32_t column = 0; column < columns; column++) {
+                    for (std::uint32_t row = 0; row < column + 2; row++) {
+                        topology.atomics.push_back({level, column, row});
+                    }
+                }
+            } else {
+                for (std::uint32_t i = 0; i < atomics_per_level; i++) {
+                    topology.atomics.push_back({level, i, topology_atomic::no_row});
+                }
+            }
+        }
+
+        coupled.submodels = topology.submodels.size() - coupled.first_submodel;
+        coupled.couplings = topology.couplings.size() - coupled.first_coupling;
+        topology.coupleds.push_back(coupled);
+    }
+    return topology;
+}
+
+// Flattens a topology into the coupled model of its last level holding every atomic directly. Every path of
+// couplings from an input port of the last level to an atomic becomes an EIC, from an atomic to an atomic an IC
+// and from an atomic to an output port of the last level an EOC, so messages reach the same ports the same
+// amount of times without crossing the levels.
+devstone_topology flatten_devstone_topology(const devstone_topology& topology) {
+    devstone_topology flat;
+    flat.kind = topology.kind;
+    flat.width = topology.width;
+    flat.depth = topology.depth;
+    if (topology.coupleds.empty()) return flat;
+
+    const std::uint32_t no_parent = UINT32_MAX;
+    const std::uint32_t root = topology.coupleds.size() - 1;
+    const std::size_t ports = coupled_out2 + 1;
+    auto slot = [ports](std::uint32_t coupled, topology_port port) { return coupled * ports + port; };
+
+    std::vector<std::uint32_t> atomic_parent(topology.atomics.size(), no_parent);
+    std::vector<std::uint32_t> coupled_parent(topology.coupleds.size(), no_parent);
+    for (std::uint32_t c = 0; c < topology.coupleds.size(); c++) {
+        const topology_coupled& coupled = topology.coupleds[c];
+        for (std::uint32_t s = coupled.first_submodel; s < coupled.first_submodel + coupled.submodels; s++) {
+            topology_model submodel = topology.submodels[s];
+            (submodel.is_coupled ? coupled_parent : atomic_parent)[submodel.index] = c;
+        }
+    }
+
+    //atomics reached from every input port of the coupled models, from the first level up since EICs only go down,
+    //and the ICs and EOCs leaving every output port of the submodels
+    std::vector<std::vector<std::uint32_t>> reached_from_input(topology.coupleds.size() * ports);
+    std::vector<std::vector<std::uint32_t>> atomic_out_couplings(topology.atomics.size());
+    std::vector<std::vector<std::uint32_t>> coupled_out_couplings(topology.coupleds.size() * ports);
+    for (std::uint32_t c = 0; c < topology.coupleds.size(); c++) {
+        const topology_coupled& coupled = topology.coupleds[c];
+        for (std::uint32_t i = coupled.first_coupling; i < coupled.first_coupling + coupled.couplings; i++) {
+            const topology_coupling& coupling = topology.couplings[i];
+            if (coupling.kind == topology_eic) {
+                std::vector<std::uint32_t>& reached = reached_from_input[slot(c, coupling.from_port)];
+                if (coupling.to.is_coupled) {
+                    const std::vector<std::uint32_t>& inner = reached_from_input[slot(coupling.to.index, coupling.to_port)];
+                    reached.insert(reached.end(), inner.begin(), inner.end());
+                } else {
+                    reached.push_back(coupling.to.index);
+                }
+            } else if (coupling.from.is_coupled) {
+                coupled_out_couplings[slot(coupling.from.index, coupling.from_port)].push_back(i);
+            } else {
+                atomic_out_couplings[coupling.from.index].push_back(i);
+            }
+        }
+    }
+
+    flat.atomics = topology.atomics;
+    flat.submodels.reserve(topology.atomics.size());
+    for (std::uint32_t a = 0; a < topology.atomics.size(); a++) {
+        flat.submodels.push_back(topology_model{a, false});
+    }
+    for (topology_port port : {coupled_in1, coupled_in2}) {
+        for (std::uint32_t to : reached_from_input[slot(root, port)]) {
+            flat.couplings.push_back({topology_eic, port, atomic_in, topology_model{0, true}, topology_model{to, false}});
+        }
+    }
+
+    //the couplings leaving an atomic are followed out of its coupled models through their EOCs
+    std::vector<std::uint32_t> pending;
+    for (std::uint32_t a = 0; a < topology.atomics.size(); a++) {
+        topology_model from{a, false};
+        pending.assign(atomic_out_couplings[a].begin(), atomic_out_couplings[a].end());
+        while (!pending.empty()) {
+            const topology_coupling& coupling = topology.couplings[pending.back()];
+            pending.pop_back();
+            if (coupling.kind == topology_ic) {
+                if (coupling.to.is_coupled) {
+                    for (std::uint32_t to : reached_from_input[slot(coupling.to.index, coupling.to_port)]) {
+                        flat.couplings.push_back({topology_ic, atomic_out, atomic_in, from, topology_model{to, false}});
+                    }
+                } else {
+                    flat.couplings.push_back({topology_ic, atomic_out, atomic_in, from, coupling.to});
+                }
+            } else {
+                std::uint32_t parent = (coupling.from.is_coupled ? coupled_parent : atomic_parent)[coupling.from.index];
+                if (parent == root) {
+                    flat.couplings.push_back({topology_eoc, atomic_out, coupling.to_port, from, topology_model{0, true}});
+                } else if (parent != no_parent) {
+                    const std::vector<std::uint32_t>& outer = coupled_out_couplings[slot(parent, coupling.to_port)];
+                    pending.insert(pending.end(), outer.begin(), outer.end());
+                }
+            }
+        }
+    }
+    flat.coupleds.push_back({topology.depth, 0, std::uint32_t(flat.submodels.size()), 0, std::uint32_t(flat.couplings.size())});
+    return flat;
+}
+
+#endif // TOPOLOGY_HPP
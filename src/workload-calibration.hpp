@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORKLOAD_CALIBRATION_HPP
+#define WORKLOAD_CALIBRATION_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+#include "workload-kernels.hpp"
+
+/**
+ * Kernel cycles are not a unit of time: the cost of a cycle depends on the host, the compiler and the
+ * flags of the target including the kernels. These helpers measure the cost of a cycle on this host
+ * once, cache it in a file, and translate nanosecond budgets for transitions into kernel cycles.
+ *
+ * The cache file has one line per kernel and build: "<build id> <nanoseconds per cycle>".
+ */
+
+// Identifies the code being measured, a cached value is only reused by the same kernel and build
+std::string workload_build_id(const workload& w) {
+    std::ostringstream os;
+    os << w.kernel;
+    if (w.kernel != dhrystone_kernel) {
+        os << "|" << w.buffer_bytes << "B";
+    }
+#ifdef __VERSION__
+    os << "|" << __VERSION__;
+#endif
+#ifdef __OPTIMIZE__
+    os << "|optimized";
+#else
+    os << "|O0";
+#endif
+    std::string id = os.str();
+    std::replace(id.begin(), id.end(), ' ', '_');
+    return id;
+}
+
+// Measures the cost of a kernel cycle, keeping the best of several trials of at least 20ms each
+double measure_workload_ns_per_cycle(const workload& w) {
+    using steady=std::chrono::steady_clock;
+    run_workload(w, 1000); //warming up caches and branch predictors
+
+    int cycles = 1000;
+    double best = std::numeric_limits<double>::infinity();
+    for (int trial=0; trial < 5;) {
+        auto start = steady::now();
+        run_workload(w, cycles);
+        double elapsed = std::chrono::duration<double, std::nano>(steady::now() - start).count();
+        if (elapsed < 20e6) { //too short to be meaningful
+            cycles *= 2;
+            continue;
+        }
+        best = std::min(best, elapsed / cycles);
+        trial++;
+    }
+    return best;
+}
+
+// Returns the cost of a kernel cycle in this host, measuring it only if it was not cached before
+double workload_ns_per_cycle(const workload& w, const std::string& cache_file) {
+    if (w.kernel == null_kernel) return 0; //no budget can be spent without work
+    const std::string id = workload_build_id(w);
+    {
+        std::ifstream is(cache_file);
+        std::string line;
+        while (std::getline(is, line)) {
+            std::istringstream fields(line);
+            std::string cached_id;
+            double ns_per_cycle;
+            if (fields >> cached_id >> ns_per_cycle && cached_id == id && ns_per_cycle > 0) {
+                return ns_per_cycle;
+            }
+        }
+    }
+    double ns_per_cycle = measure_workload_ns_per_cycle(w);
+    std::ofstream os(cache_file, std::ios_base::app);
+    os << id << " " << ns_per_cycle << std::endl;
+    return ns_per_cycle;
+}
+
+// Translates a budget in nanoseconds into the closest number of kernel cycles
+int workload_cycles_for(int ns, double ns_per_cycle) {
+    return (ns <= 0 || ns_per_cycle <= 0 ? 0 : static_cast<int>(std::llround(ns / ns_per_cycle)));
+}
+
+// Declares the options needed to size the transitions, either in kernel cycles or in nanoseconds
+void add_transition_cost_options(boost::program_options::options_description& desc) {
+    desc.add_options()
+    ("int-cycles", boost::program_options::value<int>(), "set the kernel cycles to expend in internal transtions: integer value")
+    ("ext-cycles", boost::program_options::value<int>(), "set the kernel cycles to expend in external transtions: integer value")
+    ("int-ns", boost::program_options::value<int>(), "set the nanoseconds of kernel work to expend in internal transitions, calibrated in this host: integer value")
+    ("ext-ns", boost::program_options::value<int>(), "set the nanoseconds of kernel work to expend in external transitions, calibrated in this host: integer value")
+    ("calibration-file", boost::program_options::value<std::string>()->default_value("kernel-calibration.txt"), "set the file caching the cost of a kernel cycle in this host")
+    ;
+}
+
+// Declares the options selecting the workload kernel run in transitions
+void add_workload_options(boost::program_options::options_description& desc) {
+    desc.add_options()
+    ("kernel", boost::program_options::value<workload_kernel>()->default_value(dhrystone_kernel, "dhrystone"), "set the workload run in transitions: dhrystone, pointer-chase, stream-fma, branchy or null")
+    ("kernel-buffer-kb", boost::program_options::value<int>()->default_value(1024), "set the working set of the pointer-chase, stream-fma and branchy kernels in KB: integer value")
+    ;
+}
+
+// Returns the workload selected by the options declared in add_workload_options
+workload selected_workload(const boost::program_options::variables_map& vm) {
+    workload w;
+    w.kernel = vm["kernel"].as<workload_kernel>();
+    w.buffer_bytes = static_cast<std::size_t>(std::max(vm["kernel-buffer-kb"].as<int>(), 1)) * 1024;
+    return w;
+}
+
+// Checks exactly one of --<transition>-cycles and --<transition>-ns was given for each transition
+bool transition_costs_are_valid(const boost::program_options::variables_map& vm) {
+    return vm.count("int-cycles") != vm.count("int-ns") && vm.count("ext-cycles") != vm.count("ext-ns");
+}
+
+// Returns true if any transition cost was given in nanoseconds, so calibration is required
+bool transition_costs_need_calibration(const boost::program_options::variables_map& vm) {
+    return vm.count("int-ns") || vm.count("ext-ns");
+}
+
+// Returns the kernel cycles for a transition ("int" or "ext") from its cycles or its nanoseconds
+int transition_cycles(const boost::program_options::variables_map& vm, const std::string& transition, double ns_per_cycle) {
+    if (vm.count(transition + "-cycles")) {
+        return vm[transition + "-cycles"].as<int>();
+    }
+    return workload_cycles_for(vm[transition + "-ns"].as<int>(), ns_per_cycle);
+}
+
+#endif // WORKLOAD_CALIBRATION_HPP
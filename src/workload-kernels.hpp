@@ -0,0 +1,239 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORKLOAD_KERNELS_HPP
+#define WORKLOAD_KERNELS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <numeric>
+#include <ostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../dhry/dhry_1.c"
+
+/**
+ * Workload kernels executed by DEVStone atomics in their transitions.
+ *
+ * - dhrystone: the classic DEVStone workload, integer and string operations in a small working set.
+ * - pointer-chase: dependent loads following a random cycle over a buffer, one cache line per hop.
+ * - stream-fma: a multiply-add streamed over three arrays filling the buffer, vectorizable.
+ * - branchy: a data dependent switch over random bytes, mispredicting most of its branches.
+ * - null: no work at all, transitions only update the model state. Used to measure engine overhead.
+ *
+ * A cycle of the memory bound kernels touches a fixed amount of elements and continues where the
+ * previous cycle stopped, so the whole buffer is covered over consecutive transitions.
+ * Buffers are allocated once per thread, no heap allocation happens while running a kernel.
+ */
+
+enum workload_kernel {dhrystone_kernel, pointer_chase_kernel, stream_fma_kernel, branchy_kernel, null_kernel};
+
+std::istream& operator>>(std::istream& in, workload_kernel& kernel) {
+    std::string input;
+    in >> input;
+    if (input == "dhrystone") {
+        kernel = dhrystone_kernel;
+    } else if (input == "pointer-chase") {
+        kernel = pointer_chase_kernel;
+    } else if (input == "stream-fma") {
+        kernel = stream_fma_kernel;
+    } else if (input == "branchy") {
+        kernel = branchy_kernel;
+    } else if (input == "null") {
+        kernel = null_kernel;
+    } else {
+        in.setstate(std::ios_base::failbit);
+    }
+    return in;
+}
+
+std::ostream& operator<<(std::ostream& os, const workload_kernel& kernel) {
+    switch (kernel) {
+        case dhrystone_kernel: return os << "dhrystone";
+        case pointer_chase_kernel: return os << "pointer-chase";
+        case stream_fma_kernel: return os << "stream-fma";
+        case branchy_kernel: return os << "branchy";
+        case null_kernel: return os << "null";
+    }
+    return os;
+}
+
+// The kernel run in transitions and the size of the working set of the memory bound kernels
+struct workload {
+    workload_kernel kernel = dhrystone_kernel;
+    std::size_t buffer_bytes = 1 << 20;
+};
+
+// Per thread state of the memory bound kernels
+class workload_buffers {
+    struct alignas(64) chase_node {
+        chase_node* next;
+    };
+
+    static constexpr std::size_t elements_per_cycle = 1024;
+
+    workload_kernel _kernel = null_kernel; //the kernel whose buffer is built, the others are left empty
+    std::size_t _bytes = 0;
+    std::vector<chase_node> _chase;
+    chase_node* _chase_cursor = nullptr;
+    std::vector<double> _a, _b, _c;
+    std::size_t _stream_cursor = 0;
+    std::vector<std::uint8_t> _branches;
+    std::size_t _branch_cursor = 0;
+    std::uint64_t _sink = 0; //keeps the result of the branchy kernel observable
+
+    template<typename T>
+    static void release(std::vector<T>& v) {
+        std::vector<T>().swap(v);
+    }
+
+public:
+    // Builds the buffer of the given kernel, only when the kernel or the size change
+    void resize(workload_kernel kernel, std::size_t bytes) {
+        if (kernel == _kernel && bytes == _bytes) return;
+        _kernel = kernel;
+        _bytes = bytes;
+        release(_chase);
+        release(_a);
+        release(_b);
+        release(_c);
+        release(_branches);
+        std::mt19937_64 rng(42); //fixed seed, every thread and run walks the same patterns
+
+        switch (kernel) {
+            case pointer_chase_kernel: {
+                //a single random cycle over all nodes (Sattolo's algorithm)
+                std::size_t nodes = std::max<std::size_t>(bytes / sizeof(chase_node), 2);
+                std::vector<std::size_t> order(nodes);
+                std::iota(order.begin(), order.end(), 0);
+                for (std::size_t i = nodes - 1; i > 0; i--) {
+                    std::swap(order[i], order[std::uniform_int_distribution<std::size_t>(0, i - 1)(rng)]);
+                }
+                _chase.assign(nodes, chase_node{nullptr});
+                for (std::size_t i = 0; i < nodes; i++) {
+                    _chase[order[i]].next = &_chase[order[(i + 1) % nodes]];
+                }
+                _chase_cursor = &_chase[0];
+                break;
+            }
+            case stream_fma_kernel: {
+                std::size_t doubles = std::max<std::size_t>(bytes / (3 * sizeof(double)), elements_per_cycle);
+                _a.assign(doubles, 0.0);
+                _b.assign(doubles, 1.0);
+                _c.assign(doubles, 0.5);
+                _stream_cursor = 0;
+                break;
+            }
+            case branchy_kernel:
+                _branches.resize(std::max<std::size_t>(bytes, elements_per_cycle));
+                for (auto& b : _branches) b = static_cast<std::uint8_t>(rng());
+                _branch_cursor = 0;
+                break;
+            case dhrystone_kernel:
+            case null_kernel:
+                break;
+        }
+    }
+
+    void chase(int cycles) {
+        chase_node* node = _chase_cursor;
+        for (long hops = static_cast<long>(cycles) * elements_per_cycle; hops > 0; hops--) {
+            node = node->next;
+        }
+        _chase_cursor = node;
+    }
+
+    void stream(int cycles) {
+        const double scale = 1.0000001;
+        std::size_t size = _a.size();
+        for (int cycle = 0; cycle < cycles; cycle++) {
+            std::size_t begin = _stream_cursor;
+            std::size_t end = std::min(begin + elements_per_cycle, size);
+            for (std::size_t i = begin; i < end; i++) {
+                _a[i] = _b[i] * scale + _c[i];
+            }
+            _stream_cursor = (end == size ? 0 : end);
+        }
+    }
+
+    void branch(int cycles) {
+        std::uint64_t acc = _sink;
+        std::size_t size = _branches.size();
+        for (int cycle = 0; cycle < cycles; cycle++) {
+            std::size_t begin = _branch_cursor;
+            std::size_t end = std::min(begin + elements_per_cycle, size);
+            for (std::size_t i = begin; i < end; i++) {
+                //a switch on random data compiles to an unpredictable jump, not to a conditional move
+                switch (_branches[i] & 7) {
+                    case 0: acc += i; break;
+                    case 1: acc ^= acc >> 3; break;
+                    case 2: acc *= 3; break;
+                    case 3: acc -= _branches[i]; break;
+                    case 4: acc = (acc << 1) | 1; break;
+                    case 5: acc += acc >> 7; break;
+                    case 6: acc ^= i * 31; break;
+                    default: acc = ~acc; break;
+                }
+            }
+            _branch_cursor = (end == size ? 0 : end);
+        }
+        _sink = acc;
+    }
+};
+
+workload_buffers& thread_workload_buffers(const workload& w) {
+    static thread_local workload_buffers buffers;
+    buffers.resize(w.kernel, w.buffer_bytes);
+    return buffers;
+}
+
+// Runs the given amount of cycles of the workload kernel in the calling thread
+void run_workload(const workload& w, int cycles) {
+    //not even initializing a kernel when there is nothing to run, the null kernel only costs this check
+    if (cycles <= 0 || w.kernel == null_kernel) return;
+    switch (w.kernel) {
+        case dhrystone_kernel:
+            thread_dhrystone().dhrystoneRun(cycles);
+            break;
+        case pointer_chase_kernel:
+            thread_workload_buffers(w).chase(cycles);
+            break;
+        case stream_fma_kernel:
+            thread_workload_buffers(w).stream(cycles);
+            break;
+        case branchy_kernel:
+            thread_workload_buffers(w).branch(cycles);
+            break;
+        case null_kernel:
+            break;
+    }
+}
+
+#endif // WORKLOAD_KERNELS_HPP
@@ -0,0 +1,34 @@
+#!/bin/zsh
+# Generates a model with the --parameters given as first argument, compiles it and runs it,
+# the rest of the arguments are given to the generated model
+THIS_PATH=${0:a:h}
+PREFIX=${THIS_PATH}/TEST_ARENA
+PARAMETERS=$1
+shift
+W=3
+D=3
+EXTERNAL=100
+INTERNAL=100
+EVENTS=${THIS_PATH}/../events.txt
+MODEL="${PREFIX}/HI_DEVSTONE_D${D}_W${W}_${PARAMETERS}"
+
+mkdir -p ${PREFIX}
+# Here we generated models for Cadmium
+echo "Generating model W:${W} D:${D} parameters:${PARAMETERS}"
+./cadmium-devstone   \
+    --kind=HI    \
+    --width=${W} \
+    --depth=${D} \
+    --ext-cycles=${EXTERNAL} \
+    --int-cycles=${INTERNAL} \
+    --event-list=${EVENTS}\
+    --parameters=${PARAMETERS} \
+    --output="${MODEL}.cpp" || exit 1
+
+echo "Compiling model"
+${CXX:-c++} -std=c++17 -I${THIS_PATH}/../src -I${THIS_PATH}/../simulators/cadmium/include \
+    "${MODEL}.cpp" -o "${MODEL}" -pthread || exit 1
+
+echo "Running model $@"
+"${MODEL}" "$@" | grep "Simulation took"
+exit $?
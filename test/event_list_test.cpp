@@ -0,0 +1,317 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/data/test_case.hpp>
+#include <boost/test/data/monomorphic.hpp>
+
+#include <sys/resource.h>
+
+#include "../src/event-text-parser.hpp"
+#include "../src/event-list-binary.hpp"
+#include "../src/event-list-sort.hpp"
+#include "../src/event-prefetcher.hpp"
+
+namespace bdata = boost::unit_test::data;
+
+struct parsed_batch {
+    double time;
+    std::vector<std::int32_t> values;
+
+    bool operator==(const parsed_batch& other) const {
+        return time == other.time && values == other.values;
+    }
+
+    bool operator!=(const parsed_batch& other) const {
+        return !(*this == other);
+    }
+};
+
+std::ostream& operator<<(std::ostream& os, const parsed_batch& batch) {
+    os << batch.time << ':';
+    for (std::int32_t value : batch.values) os << ' ' << value;
+    return os;
+}
+
+void write_file(const std::string& path, const std::string& content) {
+    std::ofstream os(path, std::ios_base::binary);
+    os << content;
+}
+
+std::vector<parsed_batch> parse_batches(const std::string& path, std::size_t chunk_bytes) {
+    std::vector<parsed_batch> batches;
+    event_text_parser parser(path, chunk_bytes);
+    while (parser.has_next()) {
+        parsed_batch batch;
+        batch.time = parser.read_batch(batch.values);
+        batches.push_back(batch);
+    }
+    return batches;
+}
+
+std::vector<event_record> read_events(const std::string& path) {
+    std::vector<event_record> events;
+    for_each_event(path, [&events](double time, std::int32_t value) { events.push_back(event_record{time, value, 0}); });
+    return events;
+}
+
+// Predicate for BOOST_CHECK_EXCEPTION, true if the message contains the text
+struct message_contains {
+    std::string text;
+
+    bool operator()(const std::runtime_error& e) const {
+        return std::string(e.what()).find(text) != std::string::npos;
+    }
+};
+
+// Sets the open files limit of the process while alive
+class open_files_limit_guard {
+public:
+    explicit open_files_limit_guard(rlim_t files) {
+        getrlimit(RLIMIT_NOFILE, &saved);
+        struct rlimit limit = saved;
+        limit.rlim_cur = files;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    ~open_files_limit_guard() {
+        setrlimit(RLIMIT_NOFILE, &saved);
+    }
+
+private:
+    struct rlimit saved;
+};
+
+const std::string test_list = "event_list_test.txt";
+const std::string test_binary_list = "event_list_test.bin";
+const std::string test_sorted_list = "event_list_test_sorted.bin";
+
+BOOST_AUTO_TEST_SUITE( event_list_test_suite)
+
+//the integer fast path, from_chars and every chunk boundary have to agree
+BOOST_DATA_TEST_CASE( parser_reads_the_text_format_test, bdata::make({1, 7, 300, 513, 4096, 1 << 18}), chunk_bytes ){
+    std::string content = "1 10\r\n1\t-11\n\n+2 +12\n2.5 13\n  3e0   14 \n";
+    std::vector<parsed_batch> expected = {{1, {10, -11}}, {2, {12}}, {2.5, {13}}, {3, {14}}};
+    //enough lines to cross the chunks and use the integer fast path, the last one without a new line
+    for (int i = 4; i < 3000; i++) {
+        content += std::to_string(i) + (i % 3 ? " " : "\t") + std::to_string(i % 7 ? i : -i) + (i + 1 < 3000 ? "\n" : "");
+        expected.push_back({double(i), {i % 7 ? i : -i}});
+    }
+    write_file(test_list, content);
+    std::vector<parsed_batch> batches = parse_batches(test_list, static_cast<std::size_t>(chunk_bytes));
+    std::remove(test_list.c_str());
+    BOOST_CHECK_EQUAL_COLLECTIONS(batches.begin(), batches.end(), expected.begin(), expected.end());
+}
+
+BOOST_DATA_TEST_CASE( parser_reads_the_limits_of_the_values_test, bdata::make({1, 1 << 18}), chunk_bytes ){
+    write_file(test_list, "1 2147483647\n2 -2147483648\n3 1000000000\n123456789012345 0\n");
+    std::vector<parsed_batch> batches = parse_batches(test_list, static_cast<std::size_t>(chunk_bytes));
+    std::remove(test_list.c_str());
+    std::vector<parsed_batch> expected = {{1, {2147483647}}, {2, {-2147483647 - 1}}, {3, {1000000000}}, {123456789012345.0, {0}}};
+    BOOST_CHECK_EQUAL_COLLECTIONS(batches.begin(), batches.end(), expected.begin(), expected.end());
+}
+
+BOOST_DATA_TEST_CASE( parser_rejects_bad_lists_telling_the_line_test, bdata::xrange(0, 5) * bdata::make({1, 1 << 18}), bad_line, chunk_bytes ){
+    const std::vector<std::string> bad_lines = {"5000 2147483648", "5000 x", "5000 1x", "1 1", "5000"};
+    const std::vector<std::string> problems = {"malformed event value", "malformed event value", "malformed event value",
+                                               "not sorted", "event without value"};
+    std::string content;
+    for (int i = 1; i <= 3000; i++) content += std::to_string(i) + " " + std::to_string(i) + "\n";
+    content += bad_lines[bad_line] + "\n";
+    write_file(test_list, content);
+    BOOST_CHECK_EXCEPTION(parse_batches(test_list, static_cast<std::size_t>(chunk_bytes)), std::runtime_error, message_contains{problems[bad_line]});
+    BOOST_CHECK_EXCEPTION(parse_batches(test_list, static_cast<std::size_t>(chunk_bytes)), std::runtime_error, message_contains{"at line 3001"});
+    std::remove(test_list.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( binary_list_keeps_every_event_test ){
+    std::vector<event_record> events;
+    for (int i = 0; i < 1000; i++) events.push_back(event_record{i * 0.1, i % 2 ? i : -i, 0});
+    events.push_back(event_record{1e300, 2147483647, 0});
+    event_list_writer writer(test_binary_list, true);
+    for (const event_record& event : events) writer.write(event.time, event.value);
+    BOOST_CHECK_EQUAL(writer.finish(), events.size());
+    BOOST_REQUIRE(is_binary_event_list(test_binary_list));
+
+    mapped_event_list mapped(test_binary_list);
+    BOOST_REQUIRE_EQUAL(mapped.size(), events.size());
+    for (std::size_t i = 0; i < events.size(); i++) {
+        BOOST_CHECK_EQUAL(mapped.begin()[i].time, events[i].time);
+        BOOST_CHECK_EQUAL(mapped.begin()[i].value, events[i].value);
+    }
+
+    //and back to text, without losing precision
+    event_list_writer text_writer(test_list, false);
+    for (const event_record& record : mapped) text_writer.write(record.time, record.value);
+    text_writer.finish();
+    std::vector<event_record> parsed = read_events(test_list);
+    std::remove(test_list.c_str());
+    std::remove(test_binary_list.c_str());
+    BOOST_REQUIRE_EQUAL(parsed.size(), events.size());
+    for (std::size_t i = 0; i < events.size(); i++) {
+        BOOST_CHECK_EQUAL(parsed[i].time, events[i].time);
+        BOOST_CHECK_EQUAL(parsed[i].value, events[i].value);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( truncated_binary_list_is_rejected_test ){
+    event_list_writer writer(test_binary_list, true);
+    for (int i = 0; i < 10; i++) writer.write(i, i);
+    writer.finish();
+    std::string bytes;
+    {
+        std::ifstream is(test_binary_list, std::ios_base::binary);
+        bytes.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+    }
+    write_file(test_binary_list, bytes.substr(0, bytes.size() - 1));
+    BOOST_CHECK_THROW(mapped_event_list{test_binary_list}, std::runtime_error);
+    std::remove(test_binary_list.c_str());
+}
+
+// Sorts an unsorted list with few distinct times. With 200000 events, the minimum memory and 20 open files,
+// there are several runs and the merge fan-in is 4, so they are merged in more than one pass.
+BOOST_DATA_TEST_CASE( sort_keeps_order_and_drops_events_test, bdata::make({0, 1, 2}), mode ){
+    const int events = 200000;
+    const int times = 5000;
+    std::string content;
+    std::vector<std::vector<std::int32_t>> values_at(times);
+    for (int i = 0; i < events; i++) {
+        int time = static_cast<int>((i * 7919L) % times);
+        std::int32_t value = (i % 5 == 0 ? 1 : events - i); //repeated values at some times, the rest decreasing
+        content += std::to_string(time) + " " + std::to_string(value) + "\n";
+        values_at[time].push_back(value);
+    }
+    write_file(test_list, content);
+
+    event_sort_options options;
+    options.memory_bytes = 0; //the minimum
+    options.dedup = (mode == 1);
+    options.coalesce = (mode == 2);
+    options.temp_prefix = "event_list_test_sort";
+    event_sort_stats stats;
+    {
+        open_files_limit_guard limit(20);
+        stats = event_list_sorter(options).sort(test_list, test_sorted_list);
+    }
+    std::vector<event_record> sorted = read_events(test_sorted_list);
+    std::remove(test_list.c_str());
+    std::remove(test_sorted_list.c_str());
+    BOOST_CHECK_EQUAL(stats.records_read, static_cast<std::uint64_t>(events));
+    BOOST_CHECK(stats.runs > 4);
+    BOOST_CHECK(stats.merge_passes > 1);
+    BOOST_CHECK(std::ifstream(options.temp_prefix + ".run0").fail());
+
+    std::vector<event_record> expected;
+    for (int time = 0; time < times; time++) {
+        std::vector<std::int32_t> values = values_at[time];
+        if (mode == 1) { //ordered by value without repetitions
+            std::sort(values.begin(), values.end());
+            values.erase(std::unique(values.begin(), values.end()), values.end());
+        } else if (mode == 2) { //the first of the input
+            values.resize(1);
+        }
+        for (std::int32_t value : values) expected.push_back(event_record{double(time), value, 0});
+    }
+    BOOST_CHECK_EQUAL(stats.records_written, expected.size());
+    BOOST_REQUIRE_EQUAL(sorted.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); i++) {
+        BOOST_CHECK_EQUAL(sorted[i].time, expected[i].time);
+        BOOST_CHECK_EQUAL(sorted[i].value, expected[i].value);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( failed_sort_removes_its_runs_test ){
+    std::string content;
+    for (int i = 100000; i > 0; i--) content += std::to_string(i) + " " + std::to_string(i) + "\n";
+    write_file(test_list, content);
+    event_sort_options options;
+    options.memory_bytes = 0;
+    options.temp_prefix = "event_list_test_failed_sort";
+    BOOST_CHECK_THROW(event_list_sorter(options).sort(test_list, "missing_directory/sorted.bin"), std::runtime_error);
+    std::remove(test_list.c_str());
+    for (int run = 0; run < 8; run++) {
+        BOOST_CHECK(std::ifstream(options.temp_prefix + ".run" + std::to_string(run)).fail());
+    }
+}
+
+BOOST_DATA_TEST_CASE( prefetcher_gives_the_batches_of_the_parser_test, bdata::make({1, 2, 64}), batches ){
+    std::string content;
+    for (int i = 0; i < 20000; i++) content += std::to_string(i / 3) + " " + std::to_string(i) + "\n";
+    write_file(test_list, content);
+    std::vector<parsed_batch> expected = parse_batches(test_list, event_text_parser::default_chunk_bytes);
+    std::vector<parsed_batch> prefetched;
+    {
+        prefetching_event_parser prefetcher(test_list, static_cast<std::size_t>(batches));
+        while (prefetcher.has_next()) {
+            parsed_batch batch;
+            batch.time = prefetcher.next_time();
+            prefetcher.take_batch(batch.values);
+            prefetched.push_back(batch);
+        }
+    }
+    std::remove(test_list.c_str());
+    BOOST_CHECK_EQUAL_COLLECTIONS(prefetched.begin(), prefetched.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE( prefetcher_rethrows_parse_errors_test ){
+    std::string content;
+    for (int i = 1; i <= 10000; i++) content += std::to_string(i) + " " + std::to_string(i) + "\n";
+    content += "10001 x\n";
+    write_file(test_list, content);
+    std::vector<std::int32_t> values;
+    std::size_t events = 0;
+    auto take_all = [&]() {
+        prefetching_event_parser prefetcher(test_list, 4);
+        while (prefetcher.has_next()) {
+            prefetcher.take_batch(values);
+            events += values.size();
+        }
+    };
+    BOOST_CHECK_EXCEPTION(take_all(), std::runtime_error, message_contains{"at line 10001"});
+    std::remove(test_list.c_str());
+    //the parser looks one event ahead, so the error comes with the batch before the bad line
+    BOOST_CHECK_EQUAL(events, 9999u);
+}
+
+//destroying the prefetcher while its producer waits on a full ring has to stop it
+BOOST_AUTO_TEST_CASE( prefetcher_stops_with_a_full_ring_test ){
+    std::string content;
+    for (int i = 0; i < 10000; i++) content += std::to_string(i) + " " + std::to_string(i) + "\n";
+    write_file(test_list, content);
+    {
+        prefetching_event_parser prefetcher(test_list, 2);
+        BOOST_CHECK(prefetcher.has_next());
+    }
+    std::remove(test_list.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,363 @@
+/**
+ * Copyright (c) 2019, Juan Lanuza
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/test/data/test_case.hpp>
+#include <boost/test/data/monomorphic.hpp>
+
+#include "test_helpers.hpp"
+#include "../src/topology.hpp"
+#include "../src/topology-binary.hpp"
+#include "../src/dynamic/LI_generator.cpp"
+#include "../src/dynamic/HI_generator.cpp"
+#include "../src/dynamic/HO_generator.cpp"
+#include "../src/dynamic/HOmod_generator.cpp"
+#include "../src/dynamic/flatten.hpp"
+
+#include <cadmium/engine/pdevs_dynamic_runner.hpp>
+#include <cadmium/logger/common_loggers.hpp>
+
+namespace bdata = boost::unit_test::data;
+
+struct transition_counts {
+    unsigned long internal = 0;
+    unsigned long external = 0;
+    unsigned long confluence = 0;
+    unsigned long messages = 0;
+};
+
+// DEVStone atomic adding its transitions to counts shared by every atomic of a model
+template<typename TIME>
+class counting_devstone_atomic : public devstone_atomic<TIME> {
+    using defs=devstone_atomic_defs;
+public:
+    using typename devstone_atomic<TIME>::input_ports;
+
+    counting_devstone_atomic() = default;
+
+    explicit counting_devstone_atomic(transition_counts* counts) : devstone_atomic<TIME>(0, 0, TIME(1)), counts(counts) {}
+
+    void internal_transition() {
+        devstone_atomic<TIME>::internal_transition();
+        counts->internal++;
+    }
+
+    void external_transition(TIME e, typename cadmium::make_message_bags<input_ports>::type mbs) {
+        devstone_atomic<TIME>::external_transition(e, mbs);
+        counts->external++;
+        counts->messages += cadmium::get_messages<typename defs::in>(mbs).size();
+    }
+
+    void confluence_transition(TIME e, typename cadmium::make_message_bags<input_ports>::type mbs) {
+        devstone_atomic<TIME>::confluence_transition(e, mbs);
+        counts->confluence++;
+        counts->messages += cadmium::get_messages<typename defs::in>(mbs).size();
+    }
+
+private:
+    transition_counts* counts = nullptr;
+};
+
+// Simulates the model of the topology, flattened or not, until it passivates, with bursts of events at the same time
+template<typename PORTS, typename... IN_PORTS>
+transition_counts simulate_counting_transitions(const devstone_topology& topology, bool flatten) {
+    transition_counts counts;
+    auto make_atomic = [&counts](const std::string& model_id) -> std::shared_ptr<cadmium::dynamic::modeling::model> {
+        return cadmium::dynamic::translate::make_dynamic_atomic_model<counting_devstone_atomic, TIME>(model_id, &counts);
+    };
+    event_inputs inputs;
+    inputs.readers = 0;
+    inputs.generators = 1;
+    inputs.generator.pattern = bursty_pattern;
+    inputs.generator.burst_size = 3;
+    inputs.generator.events = 12;
+    std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> TOP_coupled;
+    TOP_coupled = create_TOP_model<TIME, IN_PORTS...>(inputs, create_coupled_from_topology<TIME, PORTS>(topology, make_atomic));
+    if (flatten) TOP_coupled = flatten_hierarchy<TIME>(TOP_coupled);
+    cadmium::dynamic::engine::runner<TIME, cadmium::logger::not_logger> r(TOP_coupled, 0.0);
+    r.run_until_passivate();
+    return counts;
+}
+
+template<typename PORTS, typename... IN_PORTS>
+void check_flattened_model_transitions(devstone_kind kind, unsigned int width, unsigned int depth) {
+    devstone_topology topology = make_devstone_topology(kind, width, depth);
+    transition_counts hierarchical = simulate_counting_transitions<PORTS, IN_PORTS...>(topology, false);
+    transition_counts flattened = simulate_counting_transitions<PORTS, IN_PORTS...>(topology, true);
+    BOOST_CHECK(hierarchical.messages > 0);
+    BOOST_CHECK_EQUAL(flattened.internal, hierarchical.internal);
+    BOOST_CHECK_EQUAL(flattened.external, hierarchical.external);
+    BOOST_CHECK_EQUAL(flattened.confluence, hierarchical.confluence);
+    BOOST_CHECK_EQUAL(flattened.messages, hierarchical.messages);
+}
+
+BOOST_AUTO_TEST_SUITE( topology_test_suite)
+
+BOOST_DATA_TEST_CASE( topology_has_every_model_and_coupling_test, bdata::make({LI, HI, HO, HOmod}) * bdata::xrange(1,12,3) * bdata::xrange(1,12,3), kind, W, D ){
+    devstone_topology topology = make_devstone_topology(kind, W, D);
+    BOOST_CHECK_EQUAL(topology.atomics.size(), devstone_atomics(kind, W, D));
+    BOOST_CHECK_EQUAL(topology.couplings.size(), devstone_couplings(kind, W, D));
+    BOOST_REQUIRE_EQUAL(topology.coupleds.size(), D);
+
+    //every model but the root is a submodel of a single coupled model of the next level
+    std::vector<int> atomic_parents(topology.atomics.size(), 0);
+    std::vector<int> coupled_parents(topology.coupleds.size(), 0);
+    for (const topology_coupled& coupled : topology.coupleds) {
+        for (std::uint32_t s = coupled.first_submodel; s < coupled.first_submodel + coupled.submodels; s++) {
+            topology_model submodel = topology.submodels[s];
+            if (submodel.is_coupled) {
+                BOOST_CHECK_EQUAL(topology.coupleds[submodel.index].level + 1, coupled.level);
+                coupled_parents[submodel.index]++;
+            } else {
+                BOOST_CHECK_EQUAL(topology.atomics[submodel.index].level + 1, coupled.level);
+                atomic_parents[submodel.index]++;
+            }
+        }
+    }
+    BOOST_CHECK(std::all_of(atomic_parents.begin(), atomic_parents.end(), [](int parents) { return parents == 1; }));
+    BOOST_CHECK(std::all_of(coupled_parents.begin(), coupled_parents.end() - 1, [](int parents) { return parents == 1; }));
+    BOOST_CHECK_EQUAL(coupled_parents.back(), 0);
+}
+
+BOOST_DATA_TEST_CASE( loaded_snapshot_matches_saved_topology_test, bdata::make({LI, HI, HO, HOmod}) * bdata::xrange(1,12,5) * bdata::xrange(1,12,5), kind, W, D ){
+    const std::string path = "topology_test.topo";
+    devstone_topology saved = make_devstone_topology(kind, W, D);
+    save_devstone_topology(saved, path);
+    devstone_topology loaded = load_devstone_topology(path);
+    std::remove(path.c_str());
+
+    BOOST_CHECK_EQUAL(loaded.kind, saved.kind);
+    BOOST_CHECK_EQUAL(loaded.width, saved.width);
+    BOOST_CHECK_EQUAL(loaded.depth, saved.depth);
+    BOOST_REQUIRE_EQUAL(loaded.atomics.size(), saved.atomics.size());
+    BOOST_REQUIRE_EQUAL(loaded.couplings.size(), saved.couplings.size());
+    for (std::size_t i = 0; i < saved.atomics.size(); i++) {
+        BOOST_CHECK_EQUAL(loaded.atomics[i].column, saved.atomics[i].column);
+        BOOST_CHECK_EQUAL(loaded.atomics[i].row, saved.atomics[i].row);
+    }
+    for (std::size_t i = 0; i < saved.couplings.size(); i++) {
+        BOOST_CHECK_EQUAL(loaded.couplings[i].kind, saved.couplings[i].kind);
+        BOOST_CHECK_EQUAL(loaded.couplings[i].from.index, saved.couplings[i].from.index);
+        BOOST_CHECK_EQUAL(loaded.couplings[i].to.index, saved.couplings[i].to.index);
+        BOOST_CHECK_EQUAL(loaded.couplings[i].to_port, saved.couplings[i].to_port);
+    }
+}
+
+BOOST_DATA_TEST_CASE( snapshots_of_the_same_topology_are_identical_test, bdata::make({LI, HI, HO, HOmod}), kind ){
+    devstone_topology topology = make_devstone_topology(kind, 5, 4);
+    //a copy whose records have garbage in their padding
+    devstone_topology dirty = topology;
+    for (std::size_t i = 0; i < topology.couplings.size(); i++) {
+        std::memset(&dirty.couplings[i], 0xAB, sizeof(topology_coupling));
+        dirty.couplings[i].kind = topology.couplings[i].kind;
+        dirty.couplings[i].from_port = topology.couplings[i].from_port;
+        dirty.couplings[i].to_port = topology.couplings[i].to_port;
+        dirty.couplings[i].from.index = topology.couplings[i].from.index;
+        dirty.couplings[i].from.is_coupled = topology.couplings[i].from.is_coupled;
+        dirty.couplings[i].to.index = topology.couplings[i].to.index;
+        dirty.couplings[i].to.is_coupled = topology.couplings[i].to.is_coupled;
+    }
+    save_devstone_topology(topology, "topology_test_clean.topo");
+    save_devstone_topology(dirty, "topology_test_dirty.topo");
+    std::ifstream clean_file("topology_test_clean.topo", std::ios_base::binary);
+    std::ifstream dirty_file("topology_test_dirty.topo", std::ios_base::binary);
+    std::string clean((std::istreambuf_iterator<char>(clean_file)), std::istreambuf_iterator<char>());
+    std::string dirty_bytes((std::istreambuf_iterator<char>(dirty_file)), std::istreambuf_iterator<char>());
+    std::remove("topology_test_clean.topo");
+    std::remove("topology_test_dirty.topo");
+    BOOST_CHECK(!clean.empty());
+    BOOST_CHECK(clean == dirty_bytes);
+}
+
+BOOST_DATA_TEST_CASE( corrupt_snapshot_records_are_rejected_test, bdata::make({LI, HI, HO, HOmod}) * bdata::xrange(0,4), kind, corruption ){
+    const std::string path = "topology_test_corrupt.topo";
+    devstone_topology topology = make_devstone_topology(kind, 5, 4);
+    //the counts stay right, only one record is broken
+    switch (corruption) {
+        case 0: topology.couplings.back().to.index = 1000000; break;
+        case 1: topology.coupleds.back().first_submodel = 1000000; break;
+        case 2: topology.submodels.back().index = 1000000; break;
+        case 3: topology.couplings.front().to_port = static_cast<topology_port>(200); break;
+    }
+    save_devstone_topology(topology, path);
+    BOOST_CHECK_THROW(load_devstone_topology(path), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( models_from_mapped_snapshot_match_generators_test ){
+    const std::string path = "topology_test_mapped.topo";
+    save_devstone_topology(make_devstone_topology(HOmod, 7, 5), path);
+    std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> generated = create_HOmod_model(7, 5, 100, 100, 1);
+    std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> translated;
+    {
+        mapped_devstone_topology mapped(path);
+        translated = create_HOmod_model_from_topology(mapped.view(), 100, 100, 1);
+    }
+    BOOST_CHECK(to_prop_tree(generated) == to_prop_tree(translated));
+    std::remove(path.c_str());
+}
+
+BOOST_DATA_TEST_CASE( dynamic_models_from_topology_match_generators_test, bdata::xrange(2,12,3) * bdata::xrange(2,12,3), W, D ){
+    std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> generated;
+    std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> translated;
+
+    generated = create_LI_model(W, D, 100, 100, 1);
+    translated = create_LI_model_from_topology(make_devstone_topology(LI, W, D), 100, 100, 1);
+    BOOST_CHECK(to_prop_tree(generated) == to_prop_tree(translated));
+
+    generated = create_HI_model(W, D, 100, 100, 1);
+    translated = create_HI_model_from_topology(make_devstone_topology(HI, W, D), 100, 100, 1);
+    BOOST_CHECK(to_prop_tree(generated) == to_prop_tree(translated));
+
+    generated = create_HO_model(W, D, 100, 100, 1);
+    translated = create_HO_model_from_topology(make_devstone_topology(HO, W, D), 100, 100, 1);
+    BOOST_CHECK(to_prop_tree(generated) == to_prop_tree(translated));
+
+    generated = create_HOmod_model(W, D, 100, 100, 1);
+    translated = create_HOmod_model_from_topology(make_devstone_topology(HOmod, W, D), 100, 100, 1);
+    BOOST_CHECK(to_prop_tree(generated) == to_prop_tree(translated));
+}
+
+//the atomics are built in blocks of 64, these sizes give several blocks to every thread
+BOOST_DATA_TEST_CASE( parallel_build_matches_serial_build_test, bdata::make({10, 30}) * bdata::make({10, 30}), W, D ){
+    std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> serial;
+    std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> parallel;
+
+    serial = create_LI_model(W, D, 100, 100, 1, workload(), event_inputs(), 1);
+    parallel = create_LI_model(W, D, 100, 100, 1, workload(), event_inputs(), 4);
+    BOOST_CHECK(to_prop_tree(serial) == to_prop_tree(parallel));
+
+    serial = create_HI_model(W, D, 100, 100, 1, workload(), event_inputs(), 1);
+    parallel = create_HI_model(W, D, 100, 100, 1, workload(), event_inputs(), 4);
+    BOOST_CHECK(to_prop_tree(serial) == to_prop_tree(parallel));
+
+    serial = create_HO_model(W, D, 100, 100, 1, workload(), event_inputs(), 1);
+    parallel = create_HO_model(W, D, 100, 100, 1, workload(), event_inputs(), 4);
+    BOOST_CHECK(to_prop_tree(serial) == to_prop_tree(parallel));
+
+    serial = create_HOmod_model(W, D, 100, 100, 1, workload(), event_inputs(), 1);
+    parallel = create_HOmod_model(W, D, 100, 100, 1, workload(), event_inputs(), 4);
+    BOOST_CHECK(to_prop_tree(serial) == to_prop_tree(parallel));
+
+    parallel = create_HOmod_model_from_topology(make_devstone_topology(HOmod, W, D), 100, 100, 1, workload(), event_inputs(), nullptr, 4);
+    BOOST_CHECK(to_prop_tree(serial) == to_prop_tree(parallel));
+}
+
+BOOST_DATA_TEST_CASE( grown_levels_match_models_built_for_each_depth_test, bdata::xrange(2,12,3), W ){
+    const unsigned int max_depth = 8;
+    auto make_atomic = [](const std::string& model_id) -> std::shared_ptr<cadmium::dynamic::modeling::model> {
+        return cadmium::dynamic::translate::make_dynamic_atomic_model<devstone_atomic, TIME>(model_id, 100, 100, TIME(1));
+    };
+    devstone_topology topology = make_devstone_topology(HO, W, max_depth);
+    dynamic_topology_translator<TIME, HO_topology_ports> translator(topology, make_atomic);
+    for (unsigned int D = 1; D <= max_depth; D++) {
+        std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> grown;
+        std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> generated;
+        grown = create_TOP_model<TIME, coupledHO_in_port1, coupledHO_in_port2>(event_inputs(), translator.translate(D));
+        generated = create_HO_model(W, D, 100, 100, 1);
+        BOOST_CHECK(to_prop_tree(grown) == to_prop_tree(generated));
+    }
+}
+
+BOOST_DATA_TEST_CASE( flattened_models_couple_atomics_directly_test, bdata::xrange(1,12,3) * bdata::xrange(1,12,3), W, D ){
+    std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> flattened;
+    unsigned long atomics = devstone_atomics(LI, W, D);
+    unsigned long chained = (W > 1 ? W - 2 : 0) * (D - 1);
+
+    //the reader and every atomic get a single coupling, HI and HO also chain the atomics of each level
+    flattened = flatten_hierarchy<TIME>(create_LI_model(W, D, 100, 100, 1));
+    BOOST_CHECK_EQUAL(flattened->_models.size(), atomics + 1);
+    BOOST_CHECK_EQUAL(flattened->_ic.size(), atomics);
+
+    flattened = flatten_hierarchy<TIME>(create_HI_model(W, D, 100, 100, 1));
+    BOOST_CHECK_EQUAL(flattened->_models.size(), atomics + 1);
+    BOOST_CHECK_EQUAL(flattened->_ic.size(), atomics + chained);
+
+    flattened = flatten_hierarchy<TIME>(create_HO_model(W, D, 100, 100, 1));
+    BOOST_CHECK_EQUAL(flattened->_models.size(), atomics + 1);
+    BOOST_CHECK_EQUAL(flattened->_ic.size(), atomics + chained);
+    BOOST_CHECK(flattened->_eic.empty() && flattened->_eoc.empty());
+
+    //the reader reaches the first and last row of every column of the last level, every first row
+    //reaches both rows of every column of the level below, when it has atomics, and the other rows their previous row
+    unsigned long columns = W - 1;
+    unsigned long per_level = devstone_atomics(HOmod, W, 2) - 1;
+    unsigned long from_reader = 1 + (D > 1 ? 2 * columns : 0);
+    unsigned long from_first_rows = (D > 2 ? (D - 2) * columns * 2 * columns : 0);
+    flattened = flatten_hierarchy<TIME>(create_HOmod_model(W, D, 100, 100, 1));
+    BOOST_CHECK_EQUAL(flattened->_models.size(), devstone_atomics(HOmod, W, D) + 1);
+    BOOST_CHECK_EQUAL(flattened->_ic.size(), from_reader + (D - 1) * (per_level - columns) + from_first_rows);
+    BOOST_CHECK(flattened->_eic.empty() && flattened->_eoc.empty());
+}
+
+//the EICs of a flat topology are the couplings of the reader once flattened
+BOOST_DATA_TEST_CASE( flat_topology_couples_atomics_directly_test, bdata::make({LI, HI, HO, HOmod}) * bdata::xrange(1,12,3) * bdata::xrange(1,12,3), kind, W, D ){
+    devstone_topology flat = flatten_devstone_topology(make_devstone_topology(kind, W, D));
+    unsigned long atomics = devstone_atomics(kind, W, D);
+    unsigned long couplings[3] = {0, 0, 0};
+    for (const topology_coupling& coupling : flat.couplings) {
+        couplings[coupling.kind]++;
+        BOOST_CHECK(!coupling.from.is_coupled || coupling.kind == topology_eic);
+        BOOST_CHECK(!coupling.to.is_coupled || coupling.kind == topology_eoc);
+    }
+    BOOST_REQUIRE_EQUAL(flat.coupleds.size(), 1);
+    BOOST_CHECK_EQUAL(flat.coupleds[0].level, D);
+    BOOST_CHECK_EQUAL(flat.coupleds[0].submodels, atomics);
+    BOOST_CHECK_EQUAL(flat.coupleds[0].couplings, flat.couplings.size());
+
+    //HO also has the EOCs of the atomics of the last level to its second output
+    unsigned long chained = (W > 1 ? W - 2 : 0) * (D - 1);
+    unsigned long columns = W - 1;
+    BOOST_CHECK_EQUAL(couplings[topology_eoc], 1 + (kind == HO && D > 1 ? columns : 0));
+    unsigned long per_level = devstone_atomics(HOmod, W, 2) - 1;
+    switch (kind) {
+        case LI:
+            BOOST_CHECK_EQUAL(couplings[topology_eic] + couplings[topology_ic], atomics);
+            break;
+        case HI:
+        case HO:
+            BOOST_CHECK_EQUAL(couplings[topology_eic] + couplings[topology_ic], atomics + chained);
+            break;
+        case HOmod:
+            BOOST_CHECK_EQUAL(couplings[topology_eic] + couplings[topology_ic], 1 + (D > 1 ? 2 * columns : 0) + (D - 1) * (per_level - columns) + (D > 2 ? (D - 2) * columns * 2 * columns : 0));
+            break;
+    }
+}
+
+BOOST_DATA_TEST_CASE( flattened_models_make_the_same_transitions_test, bdata::make({1, 4}) * bdata::make({1, 2, 4}), W, D ){
+    check_flattened_model_transitions<LI_topology_ports, coupledLI_in_port>(LI, W, D);
+    check_flattened_model_transitions<HI_topology_ports, coupledHI_in_port>(HI, W, D);
+    check_flattened_model_transitions<HO_topology_ports, coupledHO_in_port1, coupledHO_in_port2>(HO, W, D);
+    check_flattened_model_transitions<HOmod_topology_ports, coupledHOmod_in_port1, coupledHOmod_in_port2>(HOmod, W, D);
+}
+
+BOOST_AUTO_TEST_SUITE_END()